@@ -27,6 +27,117 @@ void ako_free_string(const char* str);
 // Caller gets ownership of the returned element
 // Please free it using ako_elem_destroy
 ako_elem_t* ako_parse(const char* source);
+// Same as ako_parse but only reads length bytes, the source doesn't need to be NUL terminated.
+// Handy for parsing mmapped files or slices of a bigger buffer in place.
+ako_elem_t* ako_parse_n(const char* source, size_t length);
+
+// Used when ako_parse_opts_t.max_depth is left at 0
+#define AKO_DEFAULT_MAX_DEPTH 512
+
+typedef struct
+{
+    // How many tables and arrays can be nested inside each other, the root counts as one.
+    // Going deeper gives back an error instead of parsing any further.
+    size_t max_depth;
+    // Only used by ako_parse_select and ako_doc_parse_lazy. Parts that weren't selected or loaded yet are normally
+    // skipped by matching brackets, which misses most mistakes in them. Setting this first runs the whole source
+    // through the parser without building anything, so every error ako_parse would give is reported up front.
+    bool check_skipped;
+} ako_parse_opts_t;
+
+// Same as ako_parse_n with control over how the source is parsed, opts can be NULL for the defaults.
+ako_elem_t* ako_parse_ex(const char* source, size_t length, const ako_parse_opts_t* opts);
+
+// Same result as ako_parse_n but big sources are split between top level entries and parsed on up to nthreads
+// threads at once, 0 uses one for each core. Only splits right after a top level table or array, so a source made
+// of nothing but plain values gets parsed on one thread. Custom allocators have to be thread safe to use this.
+ako_elem_t* ako_parse_parallel(const char* source, size_t length, size_t nthreads);
+
+// Parses n separate sources on up to threads threads at once, 0 uses one for each core. out[i] gets the same thing
+// ako_parse_n(sources[i], lengths[i]) would give back and the caller owns each of them. lengths can be NULL if every
+// source is NUL terminated. Threads grab the next source as soon as they're free, biggest first, so a few big files
+// among lots of small ones don't leave the rest waiting. Custom allocators have to be thread safe to use this.
+void ako_parse_batch(const char** sources, const size_t* lengths, size_t n, ako_elem_t** out, unsigned threads);
+
+// Callbacks for ako_parse_events, any of them can be left NULL to ignore that kind of event.
+// Return false from one to stop parsing. Strings and keys aren't NUL terminated and are only valid during the call.
+typedef struct
+{
+    // Dotted keys give one call for each part with the value coming after the last one, so a.b 1 shows up as
+    // on_key("a"), on_key("b"), on_int(1). ako_parse puts every a.* key in the same table.
+    bool (*on_key)(void* ud, const char* key, size_t length);
+    // The root is a table too, unless it's a braced array
+    bool (*on_table_begin)(void* ud);
+    bool (*on_table_end)(void* ud);
+    // Vectors show up as arrays of numbers, same as they do through ako_elem_array_get
+    bool (*on_array_begin)(void* ud);
+    bool (*on_array_end)(void* ud);
+    bool (*on_null)(void* ud);
+    bool (*on_bool)(void* ud, bool value);
+    bool (*on_int)(void* ud, ako_int value);
+    bool (*on_float)(void* ud, ako_float value);
+    bool (*on_string)(void* ud, const char* str, size_t length);
+    bool (*on_shorttype)(void* ud, const char* str, size_t length);
+} ako_handler_t;
+
+// Parses source without building any elements, everything in it is handed to handler as it's found.
+// Returns NULL if the whole source was read, otherwise the same error ako_parse would give, which the caller owns.
+// Events sent before an error aren't taken back. To catch a dotted key going into something that isn't a table every
+// key is remembered until the end, values never are.
+ako_elem_t* ako_parse_events(const char* source, size_t length, const ako_handler_t* handler, void* ud);
+
+// Only builds the parts of the source under the given paths, everything else is skipped over without allocating.
+// Paths are the same as ako_elem_get's, e.g "db.primary". Tables on the way to a path are made even if the path
+// itself isn't found. Arrays can't be partly selected, a path that goes into one keeps all of it. A key on the way
+// that holds anything else is kept as null, so ako_elem_get stops there the same as it would on the whole tree.
+// Returns an error if one of the paths is invalid.
+ako_elem_t* ako_parse_select(const char* source, size_t length, const char** paths, size_t n);
+ako_elem_t* ako_parse_select_ex(const char* source, size_t length, const char** paths, size_t n,
+                                const ako_parse_opts_t* opts);
+
+// Documents keep everything from a parse in one arena, so destroying one frees a few big chunks instead of walking
+// the whole tree. Elements in a document work with all the usual ako_elem_* functions with a couple of rules:
+// never ako_elem_destroy them yourself and never add them to a table or array outside of the document.
+// Elements you create yourself can be added to a document as normal, it takes ownership of them.
+typedef struct ako_doc ako_doc_t;
+ako_doc_t* ako_doc_parse(const char* source, size_t length, const ako_parse_opts_t* opts);
+// NULL if the source was empty, an error element if it failed to parse. Owned by the document.
+ako_elem_t* ako_doc_get_root(ako_doc_t* doc);
+void ako_doc_destroy(ako_doc_t* doc);
+
+// Same as ako_doc_parse but tables and arrays below the root are only found by matching brackets, each one is
+// parsed the first time something looks inside it. Everything works the same as a document that was parsed all
+// at once, the difference is when the work gets done. Looking at a document is no longer read only though, so
+// lock around it if more than one thread does.
+// source isn't copied and has to stay around until the document is destroyed.
+ako_doc_t* ako_doc_parse_lazy(const char* source, size_t length, const ako_parse_opts_t* opts);
+// Mistakes inside a table or array only show up when it gets loaded, it's left empty and the first of those errors
+// is kept here. NULL if there hasn't been one. Owned by the document.
+ako_elem_t* ako_doc_get_error(ako_doc_t* doc);
+
+// For parsing lots of sources one after another, e.g. a message per request. Everything a parse allocates, the
+// elements, keys and the parser's own buffers, is kept and reused by the next one so once it has seen something the
+// size of what it usually gets, parsing doesn't allocate at all. One parser per thread, they don't lock.
+typedef struct ako_parser ako_parser_t;
+// opts can be NULL for the defaults
+ako_parser_t* ako_parser_create(const ako_parse_opts_t* opts);
+// Gives back the same as ako_parse_n, but the result belongs to the parser and is gone at the next ako_parser_parse or
+// ako_parser_destroy. It's a document element, so the same rules as ako_doc_parse apply and it's never destroyed.
+ako_elem_t* ako_parser_parse(ako_parser_t* parser, const char* source, size_t length);
+void ako_parser_destroy(ako_parser_t* parser);
+
+// Incremental parsing for when the source shows up in pieces, e.g from a pipe or socket.
+// Chunks can be split anywhere, even in the middle of a string, number or comment, and are only
+// read during the call to ako_stream_feed so they can be reused straight after. The tree is built as chunks come in,
+// only a statement cut off at the end of a chunk is held on to until the next one.
+typedef struct ako_stream ako_stream_t;
+ako_stream_t* ako_stream_begin();
+// Returns false once the stream has hit an error, there's no point feeding it more. Anything fed after the root
+// closes is ignored, same as ako_parse.
+// The error itself is given back by ako_stream_finish.
+bool ako_stream_feed(ako_stream_t* stream, const char* data, size_t length);
+// Frees the stream and returns the same thing ako_parse would have for the whole source.
+ako_elem_t* ako_stream_finish(ako_stream_t* stream);
 
 // Caller gets ownership of the returned string.
 // Please free it using ako_free_string
@@ -34,6 +34,9 @@ bool ako_elem_is_error(ako_elem_t* elem);
 
 // You transfer ownership of the element to the given table or array.
 // Calling ako_elem_table_remove or ako_elem_array_remove will free the element.
+// Elements from a parse are stored right inside their table or array instead of on their own. Removing an entry
+// moves the ones after it down, so pointers to those from before the remove can't be used anymore.
+// Elements you added yourself stay where they are.
 
 // Table
 ako_elem_t* ako_elem_table_add(ako_elem_t* table, const char* key, ako_elem_t* value);
@@ -44,12 +47,41 @@ ako_elem_t* ako_elem_table_get_value_at(ako_elem_t* table, size_t index);
 void ako_elem_table_remove(ako_elem_t* table, const char* key);
 bool ako_elem_table_contains(ako_elem_t* table, const char* key);
 
+// Keys
+// Tables from a parse store each distinct key once for the whole document and an ako_key_t is a handle to one.
+// Looking up with a handle compares pointers instead of strings, handy for keys you look up over and over.
+typedef const struct ako_key* ako_key_t;
+// Returns NULL if no table in the document has the key, or if table didn't come from a parse.
+// The handle stays valid for as long as any table from the same document is alive.
+ako_key_t ako_key_find(ako_elem_t* table, const char* key);
+const char* ako_key_get_string(ako_key_t key);
+// Works with any table, tables from other documents just fall back to comparing strings.
+ako_elem_t* ako_elem_table_get_key(ako_elem_t* table, ako_key_t key);
+
 // Array
 ako_elem_t* ako_elem_array_add(ako_elem_t* array, ako_elem_t* value);
 ako_elem_t* ako_elem_array_get(ako_elem_t* array, size_t index);
 size_t ako_elem_array_get_length(ako_elem_t* array);
 void ako_elem_array_remove(ako_elem_t* array, size_t index);
 
+// Number arrays
+// Arrays from a parse holding nothing but ints, or nothing but floats, are packed into a plain C array.
+// These return it without copying, or NULL if the array isn't packed with that kind of number.
+// ako_elem_array_get unpacks the array and so does changing it, after that the pointer is no good.
+const ako_int* ako_elem_array_ints(ako_elem_t* array);
+const ako_float* ako_elem_array_floats(ako_elem_t* array);
+// Copies up to n numbers into out and returns how many were copied. Works on any array, it just stops at the first
+// element that isn't the right type. Doesn't unpack anything.
+size_t ako_elem_array_get_ints(ako_elem_t* array, ako_int* out, size_t n);
+size_t ako_elem_array_get_floats(ako_elem_t* array, ako_float* out, size_t n);
+
+// Vectors
+// Vectors like 800x600 are arrays too, these read a 2, 3 or 4 long array of numbers without unpacking it.
+// Ints are converted to floats, for the exact ints use ako_elem_array_ints instead.
+ako_vec2_t ako_elem_get_vec2(ako_elem_t* elem);
+ako_vec3_t ako_elem_get_vec3(ako_elem_t* elem);
+ako_vec4_t ako_elem_get_vec4(ako_elem_t* elem);
+
 // Setters, will reset the type of the element
 void ako_elem_set_null(ako_elem_t* elem);
 void ako_elem_set_string(ako_elem_t* elem, const char* str);
@@ -78,4 +110,14 @@ ako_elem_t* ako_elem_create_errorf(const char* fmt, ...);
 // Returns the found element or NULL if not found
 // If an error occurs, it will return an error element
 // If ignore_error is true, it will return NULL if an error occurs
-ako_elem_t* ako_elem_get(ako_elem_t* root, const char* path);
\ No newline at end of file
+ako_elem_t* ako_elem_get(ako_elem_t* root, const char* path);
+
+// Same paths as ako_elem_get but split up once, handy for paths you look up over and over.
+// Returns NULL if the path isn't valid.
+typedef struct ako_path ako_path_t;
+ako_path_t* ako_path_compile(const char* path);
+void ako_path_destroy(ako_path_t* path);
+// Never allocates, returns NULL if nothing is at the path
+ako_elem_t* ako_elem_get_path(ako_elem_t* root, const ako_path_t* path);
+// Looks up n paths in one go, out[i] gets whatever is at paths[i] or NULL. Returns how many were found.
+size_t ako_elem_get_many(ako_elem_t* root, const char** paths, size_t n, ako_elem_t** out);
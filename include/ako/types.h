@@ -9,6 +9,21 @@
 typedef int64_t ako_int;
 typedef double ako_float;
 
+typedef struct
+{
+    ako_float x, y;
+} ako_vec2_t;
+
+typedef struct
+{
+    ako_float x, y, z;
+} ako_vec3_t;
+
+typedef struct
+{
+    ako_float x, y, z, w;
+} ako_vec4_t;
+
 typedef struct
 {
     void* (*malloc_func)(size_t);
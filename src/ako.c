@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #include <ako/ako.h>
 #include <assert.h>
+#include <inttypes.h>
 #include <malloc.h>
 #include <stdbool.h>
 #include <string.h>
@@ -48,67 +49,65 @@ void ako_free_string(const char* str)
 
 ako_elem_t* ako_parse(const char* source)
 {
-    if (source == NULL || strlen(source) == 0)
+    if (source == NULL)
     {
         return NULL;
     }
 
-    ako_elem_t* err = NULL;
-    dyn_array_t tokens = ako_tokenize(source, &err, false);
-    if (err != NULL)
-    {
-        // uh oh
-        return err;
-    }
+    return ako_parse_n(source, strlen(source));
+}
 
-    if (tokens.size == 0)
+ako_elem_t* ako_parse_n(const char* source, size_t length)
+{
+    return ako_parse_ex(source, length, NULL);
+}
+
+ako_elem_t* ako_parse_ex(const char* source, size_t length, const ako_parse_opts_t* opts)
+{
+    if (source == NULL || length == 0)
     {
-        // no tokens
         return NULL;
     }
 
-    /*for(size_t i = 0; i < tokens.size; i++)
-    {
-        token_t* token = dyn_array_get(&tokens, i);
-        static char start_str[32];
-        static char end_str[32];
-        location_format(&token->start, &start_str[0], sizeof(start_str));
-        location_format(&token->end, &end_str[0], sizeof(end_str));
-        printf("Token: %s, %s to %s", TokenType_Strings[token->type], start_str, end_str);
-
-        char* sym = "-";
-        switch (token->type)
-        {
-        case AKO_TT_STRING:
-        case AKO_TT_IDENT:
-            printf(" [ %s ]", token->value_string);
-            break;
-        case AKO_TT_INT:
-            printf(" [ %ld ]", token->value_int);
-            break;
-        case AKO_TT_BOOL:
-            if (token->value_int == 1)
-            {
-                sym = "+";
-            }
-            printf(" [ %s ]", sym);
-            break;
-        case AKO_TT_FLOAT:
-            printf(" [ %f ]", token->value_float);
-            break;
-        default: ;
-            break;
-        }
+    return ako_parse_source(source, length, opts, NULL);
+}
 
-        printf("\n");
-    }*/
+ako_elem_t* ako_parse_select(const char* source, size_t length, const char** paths, size_t n)
+{
+    return ako_parse_select_ex(source, length, paths, n, NULL);
+}
 
-    ako_elem_t* result = ako_parse_tokens(&tokens);
-    ako_free_tokens(&tokens);
+ako_elem_t* ako_parse_select_ex(const char* source, size_t length, const char** paths, size_t n,
+                                const ako_parse_opts_t* opts)
+{
+    assert(paths != NULL || n == 0);
+    select_tree_t* select = select_tree_create(paths, n);
+    if (select == NULL)
+    {
+        return ako_elem_create_error("Invalid path given to ako_parse_select");
+    }
+    if (source == NULL || length == 0)
+    {
+        select_tree_destroy(select);
+        return NULL;
+    }
 
+    ako_elem_t* result = ako_parse_source_select(source, length, opts, select);
+    select_tree_destroy(select);
     return result;
 }
 
+ako_elem_t* ako_parse_events(const char* source, size_t length, const ako_handler_t* handler, void* ud)
+{
+    assert(handler != NULL);
+    if (source == NULL || length == 0)
+    {
+        return NULL;
+    }
+
+    return ako_parse_source_events(source, length, NULL, handler, ud);
+}
+
 void _make_indent(dyn_string_t* out, const char* indent, size_t level)
 {
     assert(out != NULL);
@@ -119,6 +118,34 @@ void _make_indent(dyn_string_t* out, const char* indent, size_t level)
     }
 }
 
+// Packed arrays and vectors are written straight from their numbers, going through ako_elem_array_get would
+// unpack them
+static void _serialise_packed(dyn_string_t* str, ako_elem_t* elem, size_t index)
+{
+    if (elem->flags & ELEM_VECTOR)
+    {
+        if ((elem->vec_floats >> index) & 1)
+        {
+            dyn_string_append_fmt(str, "%f", elem->vec[index].f);
+        }
+        else
+        {
+            dyn_string_append_fmt(str, "%" PRId64, elem->vec[index].i);
+        }
+        return;
+    }
+
+    const ako_int* ints = ako_elem_array_ints(elem);
+    if (ints != NULL)
+    {
+        dyn_string_append_fmt(str, "%" PRId64, ints[index]);
+    }
+    else
+    {
+        dyn_string_append_fmt(str, "%f", ako_elem_array_floats(elem)[index]);
+    }
+}
+
 void _serialise(dyn_string_t* str, ako_elem_t* elem, const char* indent, size_t cur_indent, bool first_run, char** err)
 {
     if (err == NULL)
@@ -144,7 +171,7 @@ void _serialise(dyn_string_t* str, ako_elem_t* elem, const char* indent, size_t
         dyn_string_append(str, ";");
         return;
     case AT_INT:
-        dyn_string_append_fmt(str, "%d", elem->i);
+        dyn_string_append_fmt(str, "%" PRId64, elem->i);
         return;
     case AT_FLOAT:
         dyn_string_append_fmt(str, "%f", elem->f);
@@ -165,8 +192,9 @@ void _serialise(dyn_string_t* str, ako_elem_t* elem, const char* indent, size_t
             return;
         }
 
+        bool is_packed = (elem->flags & (ELEM_PACKED | ELEM_VECTOR)) != 0;
         bool is_vector = (len <= 4);
-        for (size_t i = 0; i < len; i++)
+        for (size_t i = 0; i < len && !is_packed; i++)
         {
             ako_elem_t* ae = ako_elem_array_get(elem, i);
             if (!ae && (ae->type != AT_INT && ae->type != AT_FLOAT))
@@ -186,14 +214,21 @@ void _serialise(dyn_string_t* str, ako_elem_t* elem, const char* indent, size_t
         {
             for (size_t i = 0; i < len; i++)
             {
-                ako_elem_t* ae = ako_elem_array_get(elem, i);
-                if (ae->type == AT_INT)
+                if (is_packed)
                 {
-                    dyn_string_append_fmt(str, "%d", ae->i);
+                    _serialise_packed(str, elem, i);
                 }
                 else
                 {
-                    dyn_string_append_fmt(str, "%f", ae->f);
+                    ako_elem_t* ae = ako_elem_array_get(elem, i);
+                    if (ae->type == AT_INT)
+                    {
+                        dyn_string_append_fmt(str, "%" PRId64, ae->i);
+                    }
+                    else
+                    {
+                        dyn_string_append_fmt(str, "%f", ae->f);
+                    }
                 }
                 if (i < len - 1)
                 {
@@ -209,7 +244,14 @@ void _serialise(dyn_string_t* str, ako_elem_t* elem, const char* indent, size_t
         for (size_t i = 0; i < len; i++)
         {
             _make_indent(str, indent, cur_indent + 1);
-            _serialise(str, ako_elem_array_get(elem, i), indent, cur_indent + 1, false, err);
+            if (is_packed)
+            {
+                _serialise_packed(str, elem, i);
+            }
+            else
+            {
+                _serialise(str, ako_elem_array_get(elem, i), indent, cur_indent + 1, false, err);
+            }
             dyn_string_append(str, end);
         }
         _make_indent(str, indent, cur_indent);
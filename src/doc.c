@@ -0,0 +1,207 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include <ako/ako.h>
+#include <assert.h>
+#include <string.h>
+
+#include "lex/parser.h"
+#include "private.h"
+
+static ako_doc_t* doc_create()
+{
+    ako_doc_t* doc = ako_malloc(sizeof(ako_doc_t));
+    memset(doc, 0, sizeof(ako_doc_t));
+    arena_init(&doc->arena);
+    doc->keys = intern_pool_create();
+    doc->adopted = dyn_array_create(sizeof(ako_elem_t*));
+    return doc;
+}
+
+ako_doc_t* ako_doc_parse(const char* source, size_t length, const ako_parse_opts_t* opts)
+{
+    ako_doc_t* doc = doc_create();
+    if (source != NULL && length != 0)
+    {
+        doc->root = ako_parse_source(source, length, opts, doc);
+    }
+    return doc;
+}
+
+ako_doc_t* ako_doc_parse_lazy(const char* source, size_t length, const ako_parse_opts_t* opts)
+{
+    ako_doc_t* doc = doc_create();
+    if (source == NULL || length == 0)
+    {
+        return doc;
+    }
+
+    if (opts != NULL && opts->check_skipped)
+    {
+        // One pass that builds nothing but still knows every key, so dotted keys clashing with tables that haven't
+        // been loaded are caught too. Loading can't fail after this.
+        ako_handler_t handler;
+        memset(&handler, 0, sizeof(ako_handler_t));
+        doc->root = ako_parse_source_events(source, length, opts, &handler, NULL);
+        if (doc->root != NULL)
+        {
+            return doc;
+        }
+    }
+
+    doc->source = source;
+    doc->source_len = length;
+    line_index_init(&doc->lines, source, length);
+    if (opts != NULL)
+    {
+        doc->opts = *opts;
+    }
+    doc->root = ako_parse_lazy_root(doc);
+    return doc;
+}
+
+void ako_doc_load(ako_elem_t* container)
+{
+    ako_doc_t* doc = container->doc;
+    ako_elem_t* err = ako_parse_lazy_container(doc, container);
+    if (err == NULL)
+    {
+        return;
+    }
+
+    // Whatever got parsed before the error goes, so it looks the same however far the parser got
+    ako_type_t type = container->type;
+    ako_elem_set_type(container, AT_NULL);
+    ako_elem_set_type(container, type);
+    if (doc->error == NULL)
+    {
+        doc->error = err;
+    }
+    else
+    {
+        ako_elem_destroy(err);
+    }
+}
+
+ako_elem_t* ako_doc_get_error(ako_doc_t* doc)
+{
+    assert(doc != NULL);
+    return doc->error;
+}
+
+ako_elem_t* ako_doc_get_root(ako_doc_t* doc)
+{
+    assert(doc != NULL);
+    return doc->root;
+}
+
+// Everything in the document that isn't in the arena
+static void doc_free_heap(ako_doc_t* doc)
+{
+    // Errors aren't made in the arena
+    if (doc->root != NULL && doc->root->doc == NULL)
+    {
+        ako_elem_destroy(doc->root);
+    }
+    doc->root = NULL;
+
+    for (size_t i = 0; i < doc->adopted.size; ++i)
+    {
+        ako_elem_destroy(*(ako_elem_t**)dyn_array_get(&doc->adopted, i));
+    }
+    doc->adopted.size = 0;
+}
+
+void ako_doc_destroy(ako_doc_t* doc)
+{
+    assert(doc != NULL);
+
+    doc_free_heap(doc);
+    dyn_array_destroy(&doc->adopted);
+
+    if (doc->source != NULL)
+    {
+        line_index_destroy(&doc->lines);
+    }
+    if (doc->error != NULL)
+    {
+        ako_elem_destroy(doc->error);
+    }
+
+    // Tables in the arena don't hold a reference, the document has the only one
+    intern_pool_release(doc->keys);
+    arena_destroy(&doc->arena);
+    ako_free(doc);
+}
+
+void* ako_doc_alloc(ako_doc_t* doc, size_t size)
+{
+    if (doc == NULL)
+    {
+        return ako_malloc(size);
+    }
+    return arena_alloc(&doc->arena, size);
+}
+
+void ako_doc_adopt(ako_doc_t* doc, ako_elem_t* elem)
+{
+    assert(elem->doc == NULL);
+    DYN_APPEND(&doc->adopted, elem);
+}
+
+void ako_doc_forget(ako_doc_t* doc, ako_elem_t* elem)
+{
+    for (size_t i = 0; i < doc->adopted.size; ++i)
+    {
+        if (*(ako_elem_t**)dyn_array_get(&doc->adopted, i) == elem)
+        {
+            dyn_array_remove(&doc->adopted, i);
+            return;
+        }
+    }
+}
+
+struct ako_parser
+{
+    ako_doc_t* doc; // Only ever holds the last result
+    parse_buffers_t buffers;
+    ako_parse_opts_t opts;
+};
+
+ako_parser_t* ako_parser_create(const ako_parse_opts_t* opts)
+{
+    ako_parser_t* parser = ako_malloc(sizeof(ako_parser_t));
+    memset(parser, 0, sizeof(ako_parser_t));
+    parser->doc = doc_create();
+    parse_buffers_init(&parser->buffers);
+    if (opts != NULL)
+    {
+        parser->opts = *opts;
+    }
+    return parser;
+}
+
+ako_elem_t* ako_parser_parse(ako_parser_t* parser, const char* source, size_t length)
+{
+    assert(parser != NULL);
+
+    // Back to an empty document, but the arena keeps its biggest chunk and the key pool its slots,
+    // so once they've grown to fit what's usually parsed there's nothing left to allocate
+    ako_doc_t* doc = parser->doc;
+    doc_free_heap(doc);
+    intern_pool_clear(doc->keys);
+    arena_reset(&doc->arena);
+
+    if (source != NULL && length != 0)
+    {
+        doc->root = ako_parse_source_reuse(source, length, &parser->opts, doc, &parser->buffers);
+    }
+    return doc->root;
+}
+
+void ako_parser_destroy(ako_parser_t* parser)
+{
+    assert(parser != NULL);
+    ako_doc_destroy(parser->doc);
+    parse_buffers_destroy(&parser->buffers);
+    ako_free(parser);
+}
@@ -6,60 +6,196 @@
 #include <string.h>
 
 #include "ako/ako.h"
-#include "lex/token.h"
+#include "mem/hash.h"
 #include "private.h"
 
 #define IS_TABLE_OR_ARRAY(type) (type == AT_TABLE || type == AT_ARRAY)
 
-static const char* string_cpy(const char* source)
+// Tables smaller than this are just scanned, hashing the key would cost more than the compares.
+#define TABLE_INDEX_MIN 16
+
+// Entries of a table or array live in blocks that double in size, block n holds CONTAINER_FIRST_BLOCK << n.
+// Blocks never move once they're made so the elements in them can be handed out as they are.
+#define CONTAINER_FIRST_BLOCK 4
+
+typedef struct
+{
+    uint64_t hash;
+    size_t entry; // Position in the table + 1, 0 means the slot is empty
+} table_slot_t;
+
+// Open addressing with linear probing over the positions of a table's entries.
+// The entries stay where they are so iteration keeps insertion order, this only makes finding them quick.
+typedef struct table_index
+{
+    hash_seed_t seed;
+    size_t mask; // Slot count - 1, always a power of two
+    size_t used;
+    table_slot_t* slots;
+} table_index_t;
+
+static void table_index_destroy(ako_elem_t* table);
+static void container_clear(ako_elem_t* container);
+
+// Tables and arrays in a lazy document are parsed the first time anything looks inside them
+static void container_load(ako_elem_t* container)
+{
+    if (container->flags & ELEM_LAZY)
+    {
+        ako_doc_load(container);
+    }
+}
+
+// Everything an element owns comes from the same place as the element
+static void* elem_alloc(ako_elem_t* elem, size_t size)
+{
+    return ako_doc_alloc(elem->doc, size);
+}
+
+static void elem_free(ako_elem_t* elem, void* ptr)
+{
+    if (elem->doc == NULL)
+    {
+        ako_free(ptr);
+    }
+}
+
+static const char* string_cpy_n(ako_elem_t* elem, const char* source, size_t len)
 {
-    size_t len = strlen(source);
-    size_t size = len + 1;
-    char* str = ako_malloc(size);
-    memcpy(str, source, size);
+    char* str = elem_alloc(elem, len + 1);
+    memcpy(str, source, len);
+    str[len] = '\0';
     return str;
 }
 
+static const char* string_cpy(ako_elem_t* elem, const char* source)
+{
+    return string_cpy_n(elem, source, strlen(source));
+}
+
 ako_elem_t* ako_elem_create(ako_type_t type)
 {
-    ako_elem_t* elem = ako_malloc(sizeof(ako_elem_t));
+    return ako_elem_create_in(NULL, type);
+}
+
+ako_elem_t* ako_elem_create_in(ako_doc_t* doc, ako_type_t type)
+{
+    ako_elem_t* elem = ako_doc_alloc(doc, sizeof(ako_elem_t));
     if (elem == NULL)
     {
         return NULL;
     }
     memset(elem, '\0', sizeof(ako_elem_t));
+    elem->doc = doc;
     ako_elem_set_type(elem, type);
     return elem;
 }
 
-void ako_elem_destroy(ako_elem_t* elem)
+static size_t floor_log2(size_t value)
 {
-    assert(elem != NULL);
+#if defined(__GNUC__) || defined(__clang__)
+    return (sizeof(unsigned long long) * 8 - 1) - (size_t)__builtin_clzll(value);
+#else
+    size_t log = 0;
+    while (value >>= 1)
+    {
+        log++;
+    }
+    return log;
+#endif
+}
 
-    if (IS_TABLE_OR_ARRAY(elem->type))
+// Which block an entry is in and where in that block
+static size_t block_of(size_t index, size_t* offset)
+{
+    size_t block = floor_log2(index / CONTAINER_FIRST_BLOCK + 1);
+    *offset = index - CONTAINER_FIRST_BLOCK * (((size_t)1 << block) - 1);
+    return block;
+}
+
+static size_t entry_stride(const ako_elem_t* container)
+{
+    return container->type == AT_TABLE ? sizeof(table_entry_t) : sizeof(ako_elem_t);
+}
+
+// A table_entry_t for tables, an ako_elem_t for arrays
+static void* container_entry(ako_elem_t* container, size_t index)
+{
+    assert(index < container->length);
+    size_t offset;
+    size_t block = block_of(index, &offset);
+    return (char*)container->blocks[block] + offset * entry_stride(container);
+}
+
+// Adds a zeroed entry on the end
+static void* container_push(ako_elem_t* container)
+{
+    size_t offset;
+    size_t block = block_of(container->length, &offset);
+    size_t stride = entry_stride(container);
+    if (offset == 0)
     {
-        // iterate over the dyn array and free the elements
-        dyn_array_t* array = &elem->a;
-        if (elem->type == AT_TABLE)
+        // Last block is full, only the list of blocks moves
+        size_t old_size = block * sizeof(void*);
+        if (container->doc != NULL)
         {
-            for (size_t i = 0; i < array->size; ++i)
-            {
-                table_elem_t* tableElem = dyn_array_get(array, i);
-                ako_free((void*)tableElem->key);
-                ako_elem_destroy(tableElem->value);
-            }
+            container->blocks =
+                arena_grow(&container->doc->arena, container->blocks, old_size, old_size + sizeof(void*));
+        }
+        else if (container->blocks == NULL)
+        {
+            container->blocks = ako_malloc(sizeof(void*));
         }
         else
         {
-            for (size_t i = 0; i < array->size; ++i)
-            {
-                array_elem_t* arrayElem = dyn_array_get(array, i);
-                ako_elem_destroy(arrayElem->item);
-            }
+            container->blocks = ako_realloc(container->blocks, old_size + sizeof(void*));
         }
+        container->blocks[block] = elem_alloc(container, ((size_t)CONTAINER_FIRST_BLOCK << block) * stride);
+    }
+
+    void* entry = (char*)container->blocks[block] + offset * stride;
+    memset(entry, 0, stride);
+    container->length++;
+    return entry;
+}
+
+// Moves everything after index down one
+static void container_remove(ako_elem_t* container, size_t index)
+{
+    size_t stride = entry_stride(container);
+    for (size_t i = index + 1; i < container->length; ++i)
+    {
+        memcpy(container_entry(container, i - 1), container_entry(container, i), stride);
+    }
+    container->length--;
+
+    size_t offset;
+    size_t block = block_of(container->length, &offset);
+    if (offset == 0)
+    {
+        // Last block is empty now, container_push makes a new one when it's needed again
+        elem_free(container, container->blocks[block]);
+        container->blocks[block] = NULL;
+    }
+}
+
+// Entries added with the public add functions only point at the element
+static ako_elem_t* entry_value(ako_elem_t* slot)
+{
+    return (slot->flags & ELEM_REF) ? slot->ref : slot;
+}
 
-        // gotta free the dyn_array
-        dyn_array_destroy(&elem->a);
+// Frees everything the element owns but not the element itself
+static void elem_clear(ako_elem_t* elem)
+{
+    assert(elem->doc == NULL);
+    if (IS_TABLE_OR_ARRAY(elem->type))
+    {
+        container_clear(elem);
+        if (elem->type == AT_TABLE && elem->keys != NULL)
+        {
+            intern_pool_release(elem->keys);
+        }
     }
 
     if (elem->type == AT_STRING || elem->type == AT_SHORTTYPE || elem->type == AT_ERROR)
@@ -67,10 +203,137 @@ void ako_elem_destroy(ako_elem_t* elem)
         // free the string
         ako_free((void*)elem->str);
     }
+}
+
+void ako_elem_destroy(ako_elem_t* elem)
+{
+    assert(elem != NULL);
+    if (elem->doc != NULL)
+    {
+        // Goes when the document does
+        return;
+    }
+    // Belongs to a table or array, removing it from there is what frees it
+    assert(!(elem->flags & ELEM_INLINE));
 
+    elem_clear(elem);
     ako_free(elem);
 }
 
+// Heap elements given to a document are kept track of so they can be destroyed with it
+static void adopt_child(ako_elem_t* container, ako_elem_t* child)
+{
+    // Once in a document an element can't leave it
+    assert(child->doc == NULL || child->doc == container->doc);
+    if (container->doc != NULL && child->doc == NULL)
+    {
+        ako_doc_adopt(container->doc, child);
+    }
+}
+
+static void destroy_child(ako_elem_t* container, ako_elem_t* child)
+{
+    if (container->doc != NULL && child->doc == NULL)
+    {
+        ako_doc_forget(container->doc, child);
+    }
+    ako_elem_destroy(child);
+}
+
+static void destroy_entry(ako_elem_t* container, ako_elem_t* slot)
+{
+    if (slot->flags & ELEM_REF)
+    {
+        destroy_child(container, slot->ref);
+    }
+    else if (container->doc == NULL)
+    {
+        elem_clear(slot);
+    }
+}
+
+// Destroys every entry and leaves the container empty
+static void container_clear(ako_elem_t* container)
+{
+    if (container->flags & ELEM_LAZY)
+    {
+        // Never parsed so there's nothing in it yet
+        container->flags &= ~ELEM_LAZY;
+        container->blocks = NULL;
+        container->length = 0;
+        container->index = NULL;
+        return;
+    }
+    if (container->flags & ELEM_VECTOR)
+    {
+        container->flags &= ~ELEM_VECTOR;
+        container->vec_length = 0;
+        container->vec_floats = 0;
+        memset(container->vec, 0, sizeof(container->vec));
+        return;
+    }
+    if (container->flags & ELEM_PACKED)
+    {
+        elem_free(container, container->packed);
+        container->flags &= ~ELEM_PACKED;
+        container->packed = NULL;
+        container->length = 0;
+        container->capacity = 0;
+        return;
+    }
+
+    if (container->type == AT_TABLE)
+    {
+        table_index_destroy(container);
+    }
+    if (container->doc != NULL)
+    {
+        // Nothing to free, adopted children still go with the document
+        container->blocks = NULL;
+        container->length = 0;
+        return;
+    }
+
+    // Block by block, so this goes through memory in order
+    size_t stride = entry_stride(container);
+    size_t left = container->length;
+    for (size_t block = 0; left > 0; ++block)
+    {
+        size_t count = (size_t)CONTAINER_FIRST_BLOCK << block;
+        if (count > left)
+        {
+            count = left;
+        }
+
+        char* entry = container->blocks[block];
+        for (size_t i = 0; i < count; ++i, entry += stride)
+        {
+            if (container->type == AT_TABLE)
+            {
+                table_entry_t* tableEntry = (table_entry_t*)entry;
+                if (container->keys == NULL)
+                {
+                    ako_free((void*)tableEntry->key);
+                }
+                destroy_entry(container, &tableEntry->value);
+            }
+            else
+            {
+                destroy_entry(container, (ako_elem_t*)entry);
+            }
+        }
+        ako_free(container->blocks[block]);
+        left -= count;
+    }
+
+    if (container->blocks != NULL)
+    {
+        ako_free(container->blocks);
+    }
+    container->blocks = NULL;
+    container->length = 0;
+}
+
 void ako_elem_set_type(ako_elem_t* elem, ako_type_t new_type)
 {
     assert(elem != NULL);
@@ -79,20 +342,30 @@ void ako_elem_set_type(ako_elem_t* elem, ako_type_t new_type)
         return;
     }
 
-    bool elem_is_table_array = IS_TABLE_OR_ARRAY(elem->type);
-    bool new_type_is_table_array = IS_TABLE_OR_ARRAY(new_type);
+    if (IS_TABLE_OR_ARRAY(elem->type))
+    {
+        // Tables and arrays lay their entries out differently so nothing carries over, not even between them
+        container_clear(elem);
+        if (elem->type == AT_TABLE && elem->keys != NULL && elem->doc == NULL)
+        {
+            intern_pool_release(elem->keys);
+        }
+        elem->keys = NULL;
+    }
 
-    if (elem_is_table_array && !new_type_is_table_array)
+    if (IS_TABLE_OR_ARRAY(new_type))
     {
-        // new type wont make use of the dyn array
-        dyn_array_destroy(&elem->a);
-        elem->a = (dyn_array_t){0};
+        // Blocks are only made once something gets added
+        elem->blocks = NULL;
+        elem->length = 0;
+        elem->index = NULL;
+        elem->keys = NULL;
     }
-    else if (!elem_is_table_array && new_type_is_table_array)
+
+    if (new_type == AT_TABLE && elem->doc != NULL)
     {
-        // elem isnt a table or array
-        // new type does need it.
-        elem->a = dyn_array_create(sizeof(elem_t));
+        // Tables in a document always share its keys, the document holds the reference for all of them
+        elem->keys = elem->doc->keys;
     }
 
     elem->type = new_type;
@@ -110,75 +383,403 @@ bool ako_elem_is_error(ako_elem_t* elem)
     return elem->type == AT_ERROR;
 }
 
-static table_elem_t* ako_table_find(ako_elem_t* table, const char* key)
+static void table_index_insert(table_index_t* index, uint64_t hash, size_t entry)
+{
+    size_t i = (size_t)hash & index->mask;
+    while (index->slots[i].entry != 0)
+    {
+        i = (i + 1) & index->mask;
+    }
+    index->slots[i].hash = hash;
+    index->slots[i].entry = entry + 1;
+    index->used++;
+}
+
+static void table_index_grow(ako_elem_t* table)
+{
+    table_index_t* index = table->index;
+    size_t old_count = index->mask + 1;
+    table_slot_t* old_slots = index->slots;
+
+    // Every entry is in the index, so lay the hashes out by entry to put them back in the order they were added.
+    // Slot order isn't good enough since probes wrap around, and duplicate keys have to stay first come first found.
+    size_t entries = index->used;
+    uint64_t* hashes = ako_malloc(entries * sizeof(uint64_t));
+    for (size_t i = 0; i < old_count; ++i)
+    {
+        if (old_slots[i].entry != 0)
+        {
+            hashes[old_slots[i].entry - 1] = old_slots[i].hash;
+        }
+    }
+    elem_free(table, old_slots);
+
+    size_t count = old_count * 2;
+    index->slots = elem_alloc(table, count * sizeof(table_slot_t));
+    memset(index->slots, 0, count * sizeof(table_slot_t));
+    index->mask = count - 1;
+    index->used = 0;
+    for (size_t i = 0; i < entries; ++i)
+    {
+        table_index_insert(index, hashes[i], i);
+    }
+    ako_free(hashes);
+}
+
+// key has to be the table's own copy, interned keys already know their hash
+static uint64_t table_key_hash(ako_elem_t* table, const char* key, size_t key_len)
+{
+    if (table->keys != NULL)
+    {
+        return INTERN_KEY_FROM_STR(key)->hash;
+    }
+    return hash_bytes(&table->index->seed, key, key_len);
+}
+
+static void table_index_add(ako_elem_t* table, const char* key, size_t key_len, size_t entry)
+{
+    table_index_t* index = table->index;
+    // Stay at most half full so probes stay short
+    if ((index->used + 1) * 2 > index->mask + 1)
+    {
+        table_index_grow(table);
+    }
+    table_index_insert(index, table_key_hash(table, key, key_len), entry);
+}
+
+static void table_index_build(ako_elem_t* table)
+{
+    size_t count = 32;
+    while (count < table->length * 2)
+    {
+        count *= 2;
+    }
+
+    table_index_t* index = elem_alloc(table, sizeof(table_index_t));
+    index->seed = hash_seed_random(index);
+    index->mask = count - 1;
+    index->used = 0;
+    index->slots = elem_alloc(table, count * sizeof(table_slot_t));
+    memset(index->slots, 0, count * sizeof(table_slot_t));
+    table->index = index;
+
+    for (size_t i = 0; i < table->length; ++i)
+    {
+        table_entry_t* tableEntry = container_entry(table, i);
+        table_index_add(table, tableEntry->key, strlen(tableEntry->key), i);
+    }
+}
+
+static void table_index_destroy(ako_elem_t* table)
+{
+    if (table->index == NULL)
+    {
+        return;
+    }
+    elem_free(table, table->index->slots);
+    elem_free(table, table->index);
+    table->index = NULL;
+}
+
+// Keys in tables sharing the pool are the exact same pointer, no need to look at the strings at all
+static table_entry_t* ako_table_find_interned(ako_elem_t* table, const struct ako_key* key)
+{
+    assert(key->pool == table->keys);
+    if (table->index == NULL && table->length >= TABLE_INDEX_MIN)
+    {
+        table_index_build(table);
+    }
+
+    if (table->index != NULL)
+    {
+        table_index_t* index = table->index;
+        for (size_t i = (size_t)key->hash & index->mask; index->slots[i].entry != 0; i = (i + 1) & index->mask)
+        {
+            table_entry_t* tableEntry = container_entry(table, index->slots[i].entry - 1);
+            if (tableEntry->key == key->str)
+            {
+                return tableEntry;
+            }
+        }
+        return NULL;
+    }
+
+    for (size_t i = 0; i < table->length; ++i)
+    {
+        table_entry_t* tableEntry = container_entry(table, i);
+        if (tableEntry->key == key->str)
+        {
+            return tableEntry;
+        }
+    }
+    return NULL;
+}
+
+// Finds the first entry with the key, same as a scan from the start would
+static table_entry_t* ako_table_find(ako_elem_t* table, const char* key, size_t key_len)
 {
-    dyn_array_t* array = &table->a;
-    for (size_t i = 0; i < array->size; ++i)
+    if (table->keys != NULL)
     {
-        table_elem_t* tableElem = dyn_array_get(array, i);
-        if (strcmp(tableElem->key, key) == 0)
+        const struct ako_key* interned = intern_pool_find(table->keys, key, key_len);
+        if (interned == NULL)
         {
-            return tableElem;
+            // Nothing in the whole document uses this key
+            return NULL;
+        }
+        return ako_table_find_interned(table, interned);
+    }
+
+    if (table->index == NULL && table->length >= TABLE_INDEX_MIN)
+    {
+        table_index_build(table);
+    }
+
+    if (table->index != NULL)
+    {
+        table_index_t* index = table->index;
+        uint64_t hash = hash_bytes(&index->seed, key, key_len);
+        // Earlier entries always sit earlier in the probe sequence, so the first match is the first added
+        for (size_t i = (size_t)hash & index->mask; index->slots[i].entry != 0; i = (i + 1) & index->mask)
+        {
+            if (index->slots[i].hash != hash)
+            {
+                continue;
+            }
+
+            table_entry_t* tableEntry = container_entry(table, index->slots[i].entry - 1);
+            if (strncmp(tableEntry->key, key, key_len) == 0 && tableEntry->key[key_len] == '\0')
+            {
+                return tableEntry;
+            }
+        }
+        return NULL;
+    }
+
+    for (size_t i = 0; i < table->length; ++i)
+    {
+        table_entry_t* tableEntry = container_entry(table, i);
+        if (strncmp(tableEntry->key, key, key_len) == 0 && tableEntry->key[key_len] == '\0')
+        {
+            return tableEntry;
         }
     }
     return NULL;
 }
 
+void ako_elem_table_share_keys(ako_elem_t* table, intern_pool_t* pool)
+{
+    assert(table != NULL);
+    assert(table->type == AT_TABLE);
+    assert(table->length == 0);
+    assert(table->keys == NULL);
+    assert(table->doc == NULL); // Already sharing the document's
+
+    intern_pool_retain(pool);
+    table->keys = pool;
+}
+
+static table_entry_t* table_push(ako_elem_t* table, const char* key, size_t key_len)
+{
+    table_entry_t* tableEntry = container_push(table);
+    if (table->keys != NULL)
+    {
+        tableEntry->key = intern_pool_add(table->keys, key, key_len)->str;
+    }
+    else
+    {
+        tableEntry->key = string_cpy_n(table, key, key_len);
+    }
+
+    if (table->index != NULL)
+    {
+        table_index_add(table, tableEntry->key, key_len, table->length - 1);
+    }
+    return tableEntry;
+}
+
+// The entry just points at value, whoever added it might still be holding on to it
+static void make_ref(ako_elem_t* container, ako_elem_t* slot, ako_elem_t* value)
+{
+    // Already belongs to something else
+    assert(!(value->flags & ELEM_INLINE));
+
+    adopt_child(container, value);
+    slot->flags = ELEM_REF;
+    slot->ref = value;
+}
+
+static void make_inline(ako_elem_t* container, ako_elem_t* slot, ako_type_t type)
+{
+    slot->flags = ELEM_INLINE;
+    slot->doc = container->doc;
+    ako_elem_set_type(slot, type);
+}
+
 ako_elem_t* ako_elem_table_add(ako_elem_t* table, const char* key, ako_elem_t* value)
+{
+    assert(key != NULL);
+    return ako_elem_table_add_n(table, key, strlen(key), value);
+}
+
+ako_elem_t* ako_elem_table_add_n(ako_elem_t* table, const char* key, size_t key_len, ako_elem_t* value)
 {
     assert(table != NULL);
     assert(table->type == AT_TABLE);
     assert(key != NULL);
     assert(value != NULL);
+    container_load(table);
+
+    make_ref(table, &table_push(table, key, key_len)->value, value);
+    return value;
+}
 
-    elem_t tableElem;
-    tableElem.table.key = string_cpy(key);
-    tableElem.table.value = value;
+ako_elem_t* ako_elem_table_emplace_n(ako_elem_t* table, const char* key, size_t key_len, ako_type_t type)
+{
+    assert(table != NULL);
+    assert(table->type == AT_TABLE);
+    assert(key != NULL);
+    container_load(table);
 
-    dyn_array_append(&table->a, &tableElem, sizeof(elem_t));
+    ako_elem_t* value = &table_push(table, key, key_len)->value;
+    make_inline(table, value, type);
     return value;
 }
 
+typedef struct
+{
+    ako_elem_t* table;
+    ako_elem_t* from;
+    size_t next; // Next entry of from to move
+} merge_frame_t;
+
+bool ako_elem_table_merge(ako_elem_t* table, ako_elem_t* from)
+{
+    assert(table != NULL && from != NULL);
+    assert(table->type == AT_TABLE && from->type == AT_TABLE);
+    assert(table->doc == NULL && from->doc == NULL);
+
+    // Tables a dotted key went through can go as deep as the key does, so no recursion
+    dyn_array_t stack = dyn_array_create(sizeof(merge_frame_t));
+    merge_frame_t first = {table, from, 0};
+    DYN_APPEND(&stack, first);
+    bool merged = true;
+    while (merged && stack.size > 0)
+    {
+        merge_frame_t* frame = dyn_array_get(&stack, stack.size - 1);
+        if (frame->next == frame->from->length)
+        {
+            stack.size--;
+            continue;
+        }
+
+        table_entry_t* fromEntry = container_entry(frame->from, frame->next++);
+        ako_elem_t* value = &fromEntry->value;
+        size_t key_len = strlen(fromEntry->key);
+        if (value->flags & (ELEM_DOTTED | ELEM_DOTTED_INTO))
+        {
+            // Flagged entries are the first with their key in from, so only what table had before can match
+            table_entry_t* existing = ako_table_find(frame->table, fromEntry->key, key_len);
+            if (existing != NULL)
+            {
+                ako_elem_t* target = entry_value(&existing->value);
+                // A dotted key would have gone into the table that was already there. That's fine when from only
+                // has what dotted keys put in it, anything else means from was parsed with the wrong table.
+                if ((value->flags & ELEM_DOTTED_INTO) || target->type != AT_TABLE)
+                {
+                    merged = false;
+                    break;
+                }
+
+                merge_frame_t child = {target, value, 0};
+                DYN_APPEND(&stack, child);
+                continue;
+            }
+        }
+
+        // Moved over as is, what's left behind in from is an empty null
+        ako_elem_t* slot = &table_push(frame->table, fromEntry->key, key_len)->value;
+        *slot = *value;
+        memset(value, 0, sizeof(ako_elem_t));
+        value->flags = ELEM_INLINE;
+    }
+
+    dyn_array_destroy(&stack);
+    return merged;
+}
+
+void ako_elem_table_clear_dotted(ako_elem_t* table)
+{
+    assert(table != NULL);
+    assert(table->type == AT_TABLE);
+
+    // Flagged tables are only ever inside other flagged tables or the root
+    dyn_array_t stack = dyn_array_create(sizeof(ako_elem_t*));
+    DYN_APPEND(&stack, table);
+    while (stack.size > 0)
+    {
+        ako_elem_t* elem = *(ako_elem_t**)dyn_array_get(&stack, stack.size - 1);
+        stack.size--;
+        for (size_t i = 0; i < elem->length; ++i)
+        {
+            ako_elem_t* value = &((table_entry_t*)container_entry(elem, i))->value;
+            if (value->flags & (ELEM_DOTTED | ELEM_DOTTED_INTO))
+            {
+                value->flags &= ~(ELEM_DOTTED | ELEM_DOTTED_INTO);
+                DYN_APPEND(&stack, value);
+            }
+        }
+    }
+    dyn_array_destroy(&stack);
+}
+
 ako_elem_t* ako_elem_table_get(ako_elem_t* table, const char* key)
+{
+    assert(key != NULL);
+    return ako_elem_table_get_n(table, key, strlen(key));
+}
+
+ako_elem_t* ako_elem_table_get_n(ako_elem_t* table, const char* key, size_t key_len)
 {
     assert(table != NULL);
     assert(table->type == AT_TABLE);
     assert(key != NULL);
+    container_load(table);
 
-    table_elem_t* elem = ako_table_find(table, key);
-    if (elem == NULL)
+    table_entry_t* tableEntry = ako_table_find(table, key, key_len);
+    if (tableEntry == NULL)
     {
         return NULL;
     }
-    return elem->value;
+    return entry_value(&tableEntry->value);
 }
 
 size_t ako_elem_table_get_length(ako_elem_t* table)
 {
     assert(table != NULL);
     assert(table->type == AT_TABLE);
+    container_load(table);
 
-    return table->a.size;
+    return table->length;
 }
 
 const char* ako_elem_table_get_key_at(ako_elem_t* table, size_t index)
 {
     assert(table != NULL);
     assert(table->type == AT_TABLE);
+    container_load(table);
 
-    table_elem_t* elem = dyn_array_get(&table->a, index);
-    assert(elem != NULL);
-    return elem->key;
+    table_entry_t* tableEntry = container_entry(table, index);
+    return tableEntry->key;
 }
 
 ako_elem_t* ako_elem_table_get_value_at(ako_elem_t* table, size_t index)
 {
     assert(table != NULL);
     assert(table->type == AT_TABLE);
+    container_load(table);
 
-    table_elem_t* elem = dyn_array_get(&table->a, index);
-    assert(elem != NULL);
-    return elem->value;
+    table_entry_t* tableEntry = container_entry(table, index);
+    return entry_value(&tableEntry->value);
 }
 
 void ako_elem_table_remove(ako_elem_t* table, const char* key)
@@ -186,27 +787,32 @@ void ako_elem_table_remove(ako_elem_t* table, const char* key)
     assert(table != NULL);
     assert(table->type == AT_TABLE);
     assert(key != NULL);
+    container_load(table);
 
-    table_elem_t* elem = NULL;
-    size_t elem_idx = 0;
+    table_entry_t* found = NULL;
+    size_t found_idx = 0;
 
-    dyn_array_t* array = &table->a;
-    for (size_t i = 0; i < array->size; ++i)
+    for (size_t i = 0; i < table->length; ++i)
     {
-        table_elem_t* tableElem = dyn_array_get(array, i);
-        if (strcmp(tableElem->key, key) == 0)
+        table_entry_t* tableEntry = container_entry(table, i);
+        if (strcmp(tableEntry->key, key) == 0)
         {
             // found it!
-            elem = tableElem;
-            elem_idx = i;
+            found = tableEntry;
+            found_idx = i;
         }
     }
 
-    if (elem != NULL)
+    if (found != NULL)
     {
-        ako_free((void*)elem->key);
-        ako_elem_destroy(elem->value);
-        dyn_array_remove(array, elem_idx);
+        if (table->keys == NULL)
+        {
+            elem_free(table, (void*)found->key);
+        }
+        destroy_entry(table, &found->value);
+        container_remove(table, found_idx);
+        // Everything after it moved down one, cheaper to build it again when it's next needed
+        table_index_destroy(table);
     }
 }
 
@@ -215,9 +821,218 @@ bool ako_elem_table_contains(ako_elem_t* table, const char* key)
     assert(table != NULL);
     assert(table->type == AT_TABLE);
     assert(key != NULL);
+    container_load(table);
+
+    return ako_table_find(table, key, strlen(key)) != NULL;
+}
+
+// Loads every lazy table and array under root
+static void load_all(ako_elem_t* root)
+{
+    dyn_array_t stack = dyn_array_create(sizeof(ako_elem_t*));
+    DYN_APPEND(&stack, root);
+    while (stack.size > 0)
+    {
+        ako_elem_t* elem = *(ako_elem_t**)dyn_array_get(&stack, stack.size - 1);
+        stack.size--;
+        bool is_table = elem->type == AT_TABLE;
+        size_t length = is_table ? ako_elem_table_get_length(elem) : ako_elem_array_get_length(elem);
+        if (elem->flags & (ELEM_PACKED | ELEM_VECTOR))
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < length; ++i)
+        {
+            ako_elem_t* child = is_table ? ako_elem_table_get_value_at(elem, i) : ako_elem_array_get(elem, i);
+            if (IS_TABLE_OR_ARRAY(child->type))
+            {
+                DYN_APPEND(&stack, child);
+            }
+        }
+    }
+    dyn_array_destroy(&stack);
+}
+
+ako_key_t ako_key_find(ako_elem_t* table, const char* key)
+{
+    assert(table != NULL);
+    assert(table->type == AT_TABLE);
+    assert(key != NULL);
+
+    ako_doc_t* doc = table->doc;
+    if (doc != NULL && doc->source != NULL && !doc->loaded_all)
+    {
+        // Keys are only interned once the table they're in gets parsed, a key nobody has looked at yet still
+        // has to be found like it would be in a document that was parsed all at once
+        doc->loaded_all = true;
+        load_all(doc->root);
+    }
+
+    if (table->keys == NULL)
+    {
+        return NULL;
+    }
+    return intern_pool_find(table->keys, key, strlen(key));
+}
+
+const char* ako_key_get_string(ako_key_t key)
+{
+    assert(key != NULL);
+    return key->str;
+}
+
+ako_elem_t* ako_elem_table_get_key(ako_elem_t* table, ako_key_t key)
+{
+    assert(table != NULL);
+    assert(table->type == AT_TABLE);
+    assert(key != NULL);
+    container_load(table);
+
+    table_entry_t* tableEntry;
+    if (key->pool == table->keys)
+    {
+        tableEntry = ako_table_find_interned(table, key);
+    }
+    else
+    {
+        // From some other document, has to go by the string
+        tableEntry = ako_table_find(table, key->str, key->length);
+    }
+    return tableEntry != NULL ? entry_value(&tableEntry->value) : NULL;
+}
+
+// Numbers are 8 bytes either way, kind says which they are
+static bool array_pack(ako_elem_t* array, uint8_t kind, const void* value)
+{
+    assert(array != NULL);
+    assert(array->type == AT_ARRAY);
+    assert(!(array->flags & ELEM_VECTOR));
+    container_load(array);
+
+    if (array->length == 0 && !(array->flags & ELEM_PACKED))
+    {
+        // Might have blocks left from entries that were removed
+        container_clear(array);
+        array->flags |= kind;
+        array->packed = NULL;
+        array->capacity = 0;
+    }
+    if (!(array->flags & kind))
+    {
+        return false;
+    }
+
+    if (array->length == array->capacity)
+    {
+        size_t old_size = array->capacity * sizeof(ako_int);
+        array->capacity = array->capacity == 0 ? 8 : array->capacity * 2;
+        if (array->doc != NULL)
+        {
+            array->packed = arena_grow(&array->doc->arena, array->packed, old_size, array->capacity * sizeof(ako_int));
+        }
+        else if (array->packed == NULL)
+        {
+            array->packed = ako_malloc(array->capacity * sizeof(ako_int));
+        }
+        else
+        {
+            array->packed = ako_realloc(array->packed, array->capacity * sizeof(ako_int));
+        }
+    }
+
+    memcpy((char*)array->packed + array->length * sizeof(ako_int), value, sizeof(ako_int));
+    array->length++;
+    return true;
+}
+
+bool ako_elem_array_pack_int(ako_elem_t* array, ako_int value)
+{
+    return array_pack(array, ELEM_PACKED_INT, &value);
+}
+
+bool ako_elem_array_pack_float(ako_elem_t* array, ako_float value)
+{
+    return array_pack(array, ELEM_PACKED_FLOAT, &value);
+}
+
+void ako_elem_set_vector(ako_elem_t* elem, const elem_number_t* numbers, size_t length, uint8_t floats)
+{
+    assert(elem != NULL);
+    assert(length <= 4);
+    if (elem->type == AT_ARRAY)
+    {
+        container_clear(elem);
+    }
+    else
+    {
+        ako_elem_set_type(elem, AT_ARRAY);
+    }
+
+    elem->flags |= ELEM_VECTOR;
+    elem->vec_length = (uint8_t)length;
+    elem->vec_floats = floats;
+    memcpy(elem->vec, numbers, length * sizeof(elem_number_t));
+}
+
+// Packed arrays and vectors only have bare numbers, these read one of them
+static bool number_is_float(const ako_elem_t* array, size_t index)
+{
+    if (array->flags & ELEM_VECTOR)
+    {
+        return (array->vec_floats >> index) & 1;
+    }
+    return (array->flags & ELEM_PACKED_FLOAT) != 0;
+}
 
-    table_elem_t* elem = ako_table_find(table, key);
-    return elem != NULL;
+static const elem_number_t* number_at(const ako_elem_t* array, size_t index)
+{
+    if (array->flags & ELEM_VECTOR)
+    {
+        return &array->vec[index];
+    }
+    return (const elem_number_t*)array->packed + index;
+}
+
+// Turns the numbers back into entries, anything that wants an ako_elem_t* out of the array needs them
+static void array_unpack(ako_elem_t* array)
+{
+    if (!(array->flags & (ELEM_PACKED | ELEM_VECTOR)))
+    {
+        return;
+    }
+
+    // The entries go where the numbers are kept, so work from a copy
+    ako_elem_t numbers = *array;
+    size_t length = ako_elem_array_get_length(array);
+    array->flags &= ~(ELEM_PACKED | ELEM_VECTOR);
+    array->vec_length = 0;
+    array->vec_floats = 0;
+    array->blocks = NULL;
+    array->length = 0;
+    array->index = NULL;
+    array->keys = NULL;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        ako_elem_t* value = container_push(array);
+        const elem_number_t* number = number_at(&numbers, i);
+        if (number_is_float(&numbers, i))
+        {
+            make_inline(array, value, AT_FLOAT);
+            value->f = number->f;
+        }
+        else
+        {
+            make_inline(array, value, AT_INT);
+            value->i = number->i;
+        }
+    }
+
+    if (numbers.flags & ELEM_PACKED)
+    {
+        elem_free(array, numbers.packed);
+    }
 }
 
 ako_elem_t* ako_elem_array_add(ako_elem_t* array, ako_elem_t* value)
@@ -225,11 +1040,22 @@ ako_elem_t* ako_elem_array_add(ako_elem_t* array, ako_elem_t* value)
     assert(array != NULL);
     assert(array->type == AT_ARRAY);
     assert(value != NULL);
+    container_load(array);
+
+    array_unpack(array);
+    make_ref(array, container_push(array), value);
+    return value;
+}
 
-    elem_t array_elem;
-    array_elem.array.item = value;
+ako_elem_t* ako_elem_array_emplace(ako_elem_t* array, ako_type_t type)
+{
+    assert(array != NULL);
+    assert(array->type == AT_ARRAY);
+    container_load(array);
 
-    dyn_array_append(&array->a, &array_elem, sizeof(elem_t));
+    array_unpack(array);
+    ako_elem_t* value = container_push(array);
+    make_inline(array, value, type);
     return value;
 }
 
@@ -237,31 +1063,175 @@ ako_elem_t* ako_elem_array_get(ako_elem_t* array, size_t index)
 {
     assert(array != NULL);
     assert(array->type == AT_ARRAY);
-    assert(index < array->a.size);
+    assert(index < ako_elem_array_get_length(array));
+    container_load(array);
 
-    array_elem_t* elem = dyn_array_get(&array->a, index);
-    assert(elem != NULL);
-    return elem->item;
+    array_unpack(array);
+    return entry_value(container_entry(array, index));
 }
 
 size_t ako_elem_array_get_length(ako_elem_t* array)
 {
     assert(array != NULL);
     assert(array->type == AT_ARRAY);
-    return array->a.size;
+    container_load(array);
+
+    if (array->flags & ELEM_VECTOR)
+    {
+        return array->vec_length;
+    }
+    return array->length;
 }
 
 void ako_elem_array_remove(ako_elem_t* array, size_t index)
 {
     assert(array != NULL);
     assert(array->type == AT_ARRAY);
-    assert(index < array->a.size);
+    assert(index < ako_elem_array_get_length(array));
+    container_load(array);
+
+    if (array->flags & ELEM_VECTOR)
+    {
+        // Not worth shuffling the float bits around for a few numbers
+        array_unpack(array);
+    }
+    if (array->flags & ELEM_PACKED)
+    {
+        char* at = (char*)array->packed + index * sizeof(ako_int);
+        memmove(at, at + sizeof(ako_int), (array->length - index - 1) * sizeof(ako_int));
+        array->length--;
+        return;
+    }
+
+    destroy_entry(array, container_entry(array, index));
+    container_remove(array, index);
+}
+
+const ako_int* ako_elem_array_ints(ako_elem_t* array)
+{
+    assert(array != NULL);
+    assert(array->type == AT_ARRAY);
+    container_load(array);
+
+    if ((array->flags & ELEM_VECTOR) && array->vec_floats == 0)
+    {
+        return &array->vec[0].i;
+    }
+    return (array->flags & ELEM_PACKED_INT) ? array->packed : NULL;
+}
+
+const ako_float* ako_elem_array_floats(ako_elem_t* array)
+{
+    assert(array != NULL);
+    assert(array->type == AT_ARRAY);
+    container_load(array);
+
+    if ((array->flags & ELEM_VECTOR) && array->vec_floats == (1 << array->vec_length) - 1)
+    {
+        return &array->vec[0].f;
+    }
+    return (array->flags & ELEM_PACKED_FLOAT) ? array->packed : NULL;
+}
+
+// Copies the first n numbers of kind/type out of any array, stopping early at anything else
+static size_t array_copy_numbers(ako_elem_t* array, uint8_t kind, ako_type_t type, void* out, size_t n)
+{
+    assert(array != NULL);
+    assert(array->type == AT_ARRAY);
+    assert(out != NULL || n == 0);
+    container_load(array);
+
+    size_t length = ako_elem_array_get_length(array);
+    if (n > length)
+    {
+        n = length;
+    }
+    if (array->flags & kind)
+    {
+        memcpy(out, array->packed, n * sizeof(ako_int));
+        return n;
+    }
+    if (array->flags & ELEM_PACKED)
+    {
+        // Packed with the other kind
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (array->flags & ELEM_VECTOR)
+        {
+            if (number_is_float(array, i) != (type == AT_FLOAT))
+            {
+                return i;
+            }
+            memcpy((char*)out + i * sizeof(ako_int), number_at(array, i), sizeof(ako_int));
+            continue;
+        }
+
+        ako_elem_t* value = entry_value(container_entry(array, i));
+        if (value->type != type)
+        {
+            return i;
+        }
+        memcpy((char*)out + i * sizeof(ako_int), type == AT_INT ? (void*)&value->i : (void*)&value->f,
+               sizeof(ako_int));
+    }
+    return n;
+}
 
-    array_elem_t* elem = dyn_array_get(&array->a, index);
+size_t ako_elem_array_get_ints(ako_elem_t* array, ako_int* out, size_t n)
+{
+    return array_copy_numbers(array, ELEM_PACKED_INT, AT_INT, out, n);
+}
+
+size_t ako_elem_array_get_floats(ako_elem_t* array, ako_float* out, size_t n)
+{
+    return array_copy_numbers(array, ELEM_PACKED_FLOAT, AT_FLOAT, out, n);
+}
+
+// Any array of n numbers works, not just ones that were parsed as a vector
+static void array_get_vec(ako_elem_t* elem, ako_float* out, size_t n)
+{
     assert(elem != NULL);
+    assert(elem->type == AT_ARRAY);
+    assert(ako_elem_array_get_length(elem) == n);
+    container_load(elem);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (elem->flags & (ELEM_PACKED | ELEM_VECTOR))
+        {
+            const elem_number_t* number = number_at(elem, i);
+            out[i] = number_is_float(elem, i) ? number->f : (ako_float)number->i;
+            continue;
+        }
+
+        ako_elem_t* value = entry_value(container_entry(elem, i));
+        assert(value->type == AT_INT || value->type == AT_FLOAT);
+        out[i] = value->type == AT_FLOAT ? value->f : value->type == AT_INT ? (ako_float)value->i : 0;
+    }
+}
+
+ako_vec2_t ako_elem_get_vec2(ako_elem_t* elem)
+{
+    ako_float v[2];
+    array_get_vec(elem, v, 2);
+    return (ako_vec2_t){v[0], v[1]};
+}
+
+ako_vec3_t ako_elem_get_vec3(ako_elem_t* elem)
+{
+    ako_float v[3];
+    array_get_vec(elem, v, 3);
+    return (ako_vec3_t){v[0], v[1], v[2]};
+}
 
-    ako_elem_destroy(elem->item);
-    dyn_array_remove(&array->a, index);
+ako_vec4_t ako_elem_get_vec4(ako_elem_t* elem)
+{
+    ako_float v[4];
+    array_get_vec(elem, v, 4);
+    return (ako_vec4_t){v[0], v[1], v[2], v[3]};
 }
 
 void ako_elem_set_null(ako_elem_t* elem)
@@ -277,9 +1247,9 @@ void ako_elem_set_string(ako_elem_t* elem, const char* str)
     ako_elem_set_type(elem, AT_STRING);
     if (elem->str != NULL)
     {
-        ako_free((void*)elem->str);
+        elem_free(elem, (void*)elem->str);
     }
-    elem->str = string_cpy(str);
+    elem->str = string_cpy(elem, str);
 }
 
 void ako_elem_set_int(ako_elem_t* elem, ako_int value)
@@ -300,7 +1270,7 @@ void ako_elem_set_shorttype(ako_elem_t* elem, const char* str)
 {
     assert(elem != NULL);
     ako_elem_set_type(elem, AT_SHORTTYPE);
-    elem->str = string_cpy(str);
+    elem->str = string_cpy(elem, str);
 }
 
 void ako_elem_set_bool(ako_elem_t* elem, bool value)
@@ -388,7 +1358,7 @@ ako_elem_t* ako_elem_create_error(const char* error)
 {
     // Same as string but with a different type
     ako_elem_t* elem = ako_elem_create(AT_ERROR);
-    elem->str = string_cpy(error);
+    elem->str = string_cpy(elem, error);
     return elem;
 }
 
@@ -414,103 +1384,13 @@ ako_elem_t* ako_elem_create_errorf(const char* fmt, ...)
 
 ako_elem_t* ako_elem_get(ako_elem_t* root, const char* path)
 {
-    // When tokenizatio this will be our error checking
-    // once done were using this for our current table
-    ako_elem_t* elem;
-
-    dyn_array_t tokens = ako_tokenize(path, &elem, true);
-    if (elem != NULL)
+    ako_path_t* compiled = ako_path_compile(path);
+    if (compiled == NULL)
     {
-        ako_elem_destroy(elem);
         return NULL;
     }
 
-    // We only support a small subset of the tokens
-    //  We only support the following tokens: AKO_TT_IDENT AKO_TT_STRING AKO_TT_DOT AKO_TT_INT
-    elem = root;
-    for (size_t i = 0; i < tokens.size; ++i)
-    {
-        token_t* token = dyn_array_get(&tokens, i);
-        if (token->type != AKO_TT_IDENT && token->type != AKO_TT_STRING && token->type != AKO_TT_DOT &&
-            token->type != AKO_TT_INT)
-        {
-            // no clue what do with what ever token this is
-            goto giveup;
-        }
-
-        bool is_end = false;
-        if (i == tokens.size - 1)
-        {
-            is_end = true;
-        }
-
-        if (is_end)
-        {
-            if (ako_elem_get_type(elem) == AT_ARRAY)
-            {
-                // if its an array we only support int
-                if (token->type != AKO_TT_INT)
-                {
-                    goto giveup;
-                }
-                elem = ako_elem_array_get(elem, token->value_int);
-                goto valid;
-            }
-            else
-            {
-                // Only support string or ident at the end
-                if (!(token->type == AKO_TT_STRING || token->type == AKO_TT_IDENT))
-                {
-                    goto giveup;
-                }
-
-                elem = ako_elem_table_get(elem, token->value_string);
-                goto valid;
-            }
-
-            goto giveup;
-        }
-
-        if (ako_elem_get_type(elem) == AT_ARRAY)
-        {
-            if (token->type != AKO_TT_INT)
-            {
-                goto giveup;
-            }
-
-            elem = ako_elem_array_get(elem, token->value_int);
-        }
-        else
-        {
-            if (!(token->type == AKO_TT_STRING || token->type == AKO_TT_IDENT))
-            {
-                // Unsupported
-                goto giveup;
-            }
-
-            elem = ako_elem_table_get(elem, token->value_string);
-        }
-
-        if (elem == NULL)
-        {
-            goto giveup;
-        }
-
-        // ensure our next token is a dot
-        i++;
-        token = dyn_array_get(&tokens, i);
-        if (token->type != AKO_TT_DOT)
-        {
-            // Incorrect
-            goto giveup;
-        }
-    }
-
-giveup:
-    ako_free_tokens(&tokens);
-    return NULL;
-
-valid:
-    ako_free_tokens(&tokens);
+    ako_elem_t* elem = ako_elem_get_path(root, compiled);
+    ako_path_destroy(compiled);
     return elem;
 }
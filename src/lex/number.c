@@ -0,0 +1,321 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include "number.h"
+
+#include <float.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ako/ako.h"
+#include "number_pow5.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_MIN_EXPONENT (-1023)
+#define DOUBLE_INFINITE_POWER 0x7FF
+
+static bool is_digit(char c)
+{
+    return (unsigned char)(c - '0') <= 9;
+}
+
+bool number_parse_int(const char* str, size_t len, ako_int* out)
+{
+    if (len == 0)
+    {
+        return false;
+    }
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (!is_digit(str[i]))
+        {
+            return false;
+        }
+
+        uint64_t digit = (uint64_t)(str[i] - '0');
+        if (value > ((uint64_t)INT64_MAX - digit) / 10)
+        {
+            // Doesn't fit
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+
+    *out = (ako_int)value;
+    return true;
+}
+
+static void mul_64x64(uint64_t a, uint64_t b, uint64_t* high, uint64_t* low)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t result = (__uint128_t)a * b;
+    *high = (uint64_t)(result >> 64);
+    *low = (uint64_t)result;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *low = _umul128(a, b, high);
+#else
+    uint64_t a_lo = (uint32_t)a;
+    uint64_t a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b;
+    uint64_t b_hi = b >> 32;
+
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t hi_hi = a_hi * b_hi;
+
+    uint64_t middle = lo_hi + (lo_lo >> 32) + (uint32_t)hi_lo;
+    *high = hi_hi + (middle >> 32) + (hi_lo >> 32);
+    *low = (middle << 32) | (uint32_t)lo_lo;
+#endif
+}
+
+static int leading_zeroes(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    while ((value & (UINT64_C(1) << 63)) == 0)
+    {
+        value <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Eisel-Lemire, turns w * 10^q into the bits of the nearest double.
+// Only exact for a w that wasn't truncated, see number_parse_float for how truncation is handled.
+static uint64_t compute_float(int64_t q, uint64_t w)
+{
+    if (w == 0 || q < NUMBER_POW5_MIN)
+    {
+        return 0;
+    }
+    if (q > NUMBER_POW5_MAX)
+    {
+        return (uint64_t)DOUBLE_INFINITE_POWER << DOUBLE_MANTISSA_BITS;
+    }
+
+    int lz = leading_zeroes(w);
+    w <<= lz;
+
+    // Only need the top mantissa + 3 bits to be right, the second word is only needed if they might carry.
+    size_t index = 2 * (size_t)(q - NUMBER_POW5_MIN);
+    uint64_t high;
+    uint64_t low;
+    mul_64x64(w, number_pow5_128[index], &high, &low);
+    const uint64_t precision_mask = UINT64_C(0xFFFFFFFFFFFFFFFF) >> (DOUBLE_MANTISSA_BITS + 3);
+    if ((high & precision_mask) == precision_mask)
+    {
+        uint64_t high2;
+        uint64_t low2;
+        mul_64x64(w, number_pow5_128[index + 1], &high2, &low2);
+        low += high2;
+        if (high2 > low)
+        {
+            high++;
+        }
+    }
+
+    int upperbit = (int)(high >> 63);
+    int shift = upperbit + 64 - DOUBLE_MANTISSA_BITS - 3;
+    uint64_t mantissa = high >> shift;
+    // floor(log2(10^q)) + 63, without needing any floating point
+    int64_t power2 = ((((152170 + 65536) * q) >> 16) + 63) + upperbit - lz - DOUBLE_MIN_EXPONENT;
+
+    if (power2 <= 0)
+    {
+        // Subnormal
+        if (-power2 + 1 >= 64)
+        {
+            return 0;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += (mantissa & 1);
+        mantissa >>= 1;
+        power2 = (mantissa < (UINT64_C(1) << DOUBLE_MANTISSA_BITS)) ? 0 : 1;
+        return mantissa | ((uint64_t)power2 << DOUBLE_MANTISSA_BITS);
+    }
+
+    // Exactly halfway between two doubles, round to even instead of up
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1)
+    {
+        if ((mantissa << shift) == high)
+        {
+            mantissa &= ~UINT64_C(1);
+        }
+    }
+
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    if (mantissa >= (UINT64_C(2) << DOUBLE_MANTISSA_BITS))
+    {
+        mantissa = UINT64_C(1) << DOUBLE_MANTISSA_BITS;
+        power2++;
+    }
+
+    mantissa &= ~(UINT64_C(1) << DOUBLE_MANTISSA_BITS);
+    if (power2 >= DOUBLE_INFINITE_POWER)
+    {
+        return (uint64_t)DOUBLE_INFINITE_POWER << DOUBLE_MANTISSA_BITS;
+    }
+    return mantissa | ((uint64_t)power2 << DOUBLE_MANTISSA_BITS);
+}
+
+// Only hit with more than 19 significant digits that land too close to a rounding boundary to tell from the
+// truncated value. strtod wants the decimal point of the current locale so swap ours for it.
+static bool parse_float_fallback(const char* str, size_t len, ako_float* out)
+{
+    const char* point = localeconv()->decimal_point;
+    size_t point_len = strlen(point);
+
+    char* buffer = ako_malloc(len + point_len + 1);
+    size_t written = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (str[i] == '.')
+        {
+            memcpy(buffer + written, point, point_len);
+            written += point_len;
+            continue;
+        }
+        buffer[written++] = str[i];
+    }
+    buffer[written] = '\0';
+
+    char* end = NULL;
+    *out = strtod(buffer, &end);
+    bool ok = (end == buffer + written);
+    ako_free(buffer);
+    return ok;
+}
+
+bool number_parse_float(const char* str, size_t len, ako_float* out)
+{
+    const char* iter = str;
+    const char* end = str + len;
+
+    uint64_t mantissa = 0;
+    const char* int_start = iter;
+    while (iter < end && is_digit(*iter))
+    {
+        mantissa = mantissa * 10 + (uint64_t)(*iter - '0');
+        iter++;
+    }
+    const char* int_end = iter;
+    if (int_end == int_start)
+    {
+        return false;
+    }
+
+    int64_t exponent = 0;
+    const char* frac_start = iter;
+    const char* frac_end = iter;
+    if (iter < end && *iter == '.')
+    {
+        iter++;
+        frac_start = iter;
+        while (iter < end && is_digit(*iter))
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*iter - '0');
+            iter++;
+        }
+        frac_end = iter;
+        exponent = frac_start - frac_end;
+    }
+
+    if (iter != end)
+    {
+        return false;
+    }
+
+    // More than 19 digits wont fit, keep the first 19 significant ones and remember we dropped some.
+    bool truncated = false;
+    int64_t digit_count = (int_end - int_start) + (frac_end - frac_start);
+    if (digit_count > 19)
+    {
+        const char* leading = int_start;
+        while (leading < frac_end && (*leading == '0' || *leading == '.'))
+        {
+            if (*leading == '0')
+            {
+                digit_count--;
+            }
+            leading++;
+        }
+
+        if (digit_count > 19)
+        {
+            truncated = true;
+            const uint64_t min_19_digits = UINT64_C(1000000000000000000);
+            mantissa = 0;
+            iter = int_start;
+            while (mantissa < min_19_digits && iter < int_end)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*iter - '0');
+                iter++;
+            }
+
+            if (mantissa >= min_19_digits)
+            {
+                exponent = int_end - iter;
+            }
+            else
+            {
+                iter = frac_start;
+                while (mantissa < min_19_digits && iter < frac_end)
+                {
+                    mantissa = mantissa * 10 + (uint64_t)(*iter - '0');
+                    iter++;
+                }
+                exponent = frac_start - iter;
+            }
+        }
+    }
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    // Both sides are exact doubles here so a single multiply or divide rounds correctly.
+    static const double exact_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (!truncated && exponent >= -22 && exponent <= 22 && mantissa <= (UINT64_C(1) << 53))
+    {
+        double value = (double)mantissa;
+        if (exponent < 0)
+        {
+            value = value / exact_pow10[-exponent];
+        }
+        else
+        {
+            value = value * exact_pow10[exponent];
+        }
+        *out = value;
+        return true;
+    }
+#endif
+
+    uint64_t bits = compute_float(exponent, mantissa);
+    if (truncated && bits != compute_float(exponent, mantissa + 1))
+    {
+        // The dropped digits matter, go the slow way
+        return parse_float_fallback(str, len, out);
+    }
+
+    if ((bits >> DOUBLE_MANTISSA_BITS) == DOUBLE_INFINITE_POWER)
+    {
+        // Too big to be a double
+        return false;
+    }
+
+    double value;
+    memcpy(&value, &bits, sizeof(double));
+    *out = value;
+    return true;
+}
@@ -0,0 +1,12 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <ako/types.h>
+
+// Number parsing straight from the source, no copying or NUL terminator needed and no locale involved.
+// Both return false if the text isn't a valid number or doesn't fit.
+
+// Decimal digits only.
+bool number_parse_int(const char* str, size_t len, ako_int* out);
+// Digits with a single '.' somewhere after the first one, e.g "1.5" or "2.". Correctly rounded.
+bool number_parse_float(const char* str, size_t len, ako_float* out);
@@ -6,35 +6,439 @@
 #include <assert.h>
 #include <string.h>
 
+#include "../mem/dyn_array.h"
 #include "../mem/dyn_string.h"
+#include "../mem/arena.h"
+#include "../mem/hash.h"
 #include "ako/ako.h"
 
+#define SHAPE_MIN_SLOTS 64
+#define SHAPE_NOT_TABLE 0
+
+// Events mode, every key of every table and whether it holds a table. That's all a dotted key looks at, so it can
+// fail the same way ako_parse does without any values being built.
+typedef struct
+{
+    const char* key; // Points into the source unless it had escapes
+    size_t key_len;
+    size_t table;
+    size_t child; // What the key holds, SHAPE_NOT_TABLE if it isn't a table
+    size_t next;  // Index + 1 of the table's next entry, 0 for its last
+} shape_entry_t;
+
+typedef struct
+{
+    size_t first; // Index + 1 of the first entry, 0 if there are none
+    size_t last;
+    bool indexed; // Entries are in the hash, only once a dotted key has looked in the table
+} shape_table_t;
+
+// Most tables never have a dotted key look in them, so hashing waits until one does
+typedef struct
+{
+    size_t entry;  // Index + 1, 0 for an empty slot
+    uint64_t hash; // Of the key and table together
+} shape_slot_t;
+
+typedef struct
+{
+    bool started;
+    dyn_array_t entries; // Of shape_entry_t, in the order they were found
+    dyn_array_t tables;  // Of shape_table_t, numbered from 1 so none of them is SHAPE_NOT_TABLE
+    shape_slot_t* slots;
+    size_t mask; // Slot count - 1, always a power of two
+    size_t used;
+    arena_t copies; // Keys that had to be decoded
+    hash_seed_t seed;
+} shape_t;
+
+// How many tokens we keep around, the parser never looks more than one token ahead.
+// A token pointer stays valid until LOOKAHEAD_SIZE - 1 more tokens have been pulled in after it.
+#define LOOKAHEAD_SIZE 4
+
 typedef struct
 {
-    dyn_array_t* tokens;
-    size_t index;
+    lexer_t lexer;
+    const token_buf_t* tokens;         // If set tokens come from here instead of the lexer
+    size_t token_index;                // Next token to take out of tokens
+    bool tokens_ran_out;               // Tried to read past the end of tokens
+    const char* source;                // What string and ident tokens point into
+    line_index_t* lines;               // For turning token offsets into lines for errors
+    token_t lookahead[LOOKAHEAD_SIZE]; // Ring buffer of tokens pulled from the lexer
+    size_t head;                       // Position of the current token in the ring
+    size_t count;                      // How many tokens are buffered starting from head
+    dyn_string_t scratch;              // Used to decode escaped keys
+    dyn_array_t frames;                // Tables and arrays that are still open, innermost last
+    size_t max_depth;                  // How many frames we allow before giving up
+    intern_pool_t* keys;               // Shared by every table in the document
+    ako_doc_t* doc;                    // Where elements get allocated, NULL for the heap
+    bool events;                       // Calling handler instead of building elements, see ako_parse_events
+    ako_handler_t handler;             // Missing callbacks are filled in with ones that do nothing
+    shape_t shape;                     // Events mode, keys of every table so far
+    void* ud;
+    const select_tree_t* select;       // Paths to keep for ako_parse_select, NULL to keep everything
+    bool lazy;                         // Nested tables and arrays are only marked ELEM_LAZY, see ako_doc_parse_lazy
+    size_t base_depth;                 // How deep the first frame is, when loading a lazy table or array
+    bool part;                         // Parsing a piece of a bigger document, see ako_parse_source_part
+    parse_buffers_t* buffers;          // Where frames and scratch came from and go back to, NULL if they're ours
 } state_t;
 
+static bool _next_token(state_t* state, token_t* out)
+{
+    if (state->tokens == NULL)
+    {
+        return lexer_next(&state->lexer, out);
+    }
+
+    if (state->token_index >= state->tokens->tokens.size)
+    {
+        state->tokens_ran_out = true;
+        return false;
+    }
+    token_buf_get(state->tokens, state->token_index++, out);
+    return true;
+}
+
+static token_t* peek(state_t* state, size_t offset)
+{
+    assert(offset < LOOKAHEAD_SIZE);
+    while (state->count <= offset)
+    {
+        token_t* slot = &state->lookahead[(state->head + state->count) % LOOKAHEAD_SIZE];
+        if (!_next_token(state, slot))
+        {
+            return NULL;
+        }
+        state->count++;
+    }
+
+    return &state->lookahead[(state->head + offset) % LOOKAHEAD_SIZE];
+}
+
 static token_t* _consume(state_t* state)
 {
-    if (state->index >= state->tokens->size)
+    token_t* token = peek(state, 0);
+    if (token == NULL)
     {
         return NULL;
     }
 
-    token_t* token = dyn_array_get(state->tokens, state->index);
-    state->index++;
+    state->head = (state->head + 1) % LOOKAHEAD_SIZE;
+    state->count--;
     return token;
 }
 
-static token_t* peek(state_t* state, size_t offset)
+static location_t _location(state_t* state, size_t offset)
+{
+    return line_index_find(state->lines, offset);
+}
+
+// Stand ins for callbacks the handler left out
+static bool _skip(void* ud)
+{
+    (void)ud;
+    return true;
+}
+
+static bool _skip_bool(void* ud, bool value)
+{
+    (void)ud;
+    (void)value;
+    return true;
+}
+
+static bool _skip_int(void* ud, ako_int value)
+{
+    (void)ud;
+    (void)value;
+    return true;
+}
+
+static bool _skip_float(void* ud, ako_float value)
+{
+    (void)ud;
+    (void)value;
+    return true;
+}
+
+static bool _skip_string(void* ud, const char* str, size_t length)
+{
+    (void)ud;
+    (void)str;
+    (void)length;
+    return true;
+}
+
+static const ako_handler_t _skip_handler = {
+    .on_key = _skip_string,
+    .on_table_begin = _skip,
+    .on_table_end = _skip,
+    .on_array_begin = _skip,
+    .on_array_end = _skip,
+    .on_null = _skip,
+    .on_bool = _skip_bool,
+    .on_int = _skip_int,
+    .on_float = _skip_float,
+    .on_string = _skip_string,
+    .on_shorttype = _skip_string,
+};
+
+// Called when a callback returns false, offset is where the token that caused it starts
+static ako_elem_t* _stopped(state_t* state, size_t offset)
+{
+    location_t loc = line_index_find(state->lines, offset);
+    return ako_elem_create_errorf("Stopped by the handler at %zu:%zu", loc.line, loc.column);
+}
+
+static ako_elem_t* _emit_key(state_t* state, const token_t* token)
+{
+    size_t len;
+    const char* key = token_string(state->source, token, &state->scratch, &len);
+    return state->handler.on_key(state->ud, key, len) ? NULL : _stopped(state, token->start);
+}
+
+static ako_elem_t* _emit_number(state_t* state, const token_t* token)
+{
+    bool keep_going = token->type == AKO_TT_INT ? state->handler.on_int(state->ud, token->value_int)
+                                                : state->handler.on_float(state->ud, token->value_float);
+    return keep_going ? NULL : _stopped(state, token->start);
+}
+
+static ako_elem_t* _emit_vector(state_t* state, const elem_number_t* numbers, size_t length, uint8_t floats,
+                                size_t offset)
+{
+    // Vectors are plain arrays as far as anyone outside is concerned
+    bool keep_going = state->handler.on_array_begin(state->ud);
+    for (size_t i = 0; i < length && keep_going; ++i)
+    {
+        keep_going = (floats & (1 << i)) ? state->handler.on_float(state->ud, numbers[i].f)
+                                         : state->handler.on_int(state->ud, numbers[i].i);
+    }
+    keep_going = keep_going && state->handler.on_array_end(state->ud);
+    return keep_going ? NULL : _stopped(state, offset);
+}
+
+static size_t _shape_table(state_t* state)
+{
+    shape_t* shape = &state->shape;
+    if (!shape->started)
+    {
+        shape->started = true;
+        shape->entries = dyn_array_create(sizeof(shape_entry_t));
+        shape->tables = dyn_array_create(sizeof(shape_table_t));
+        arena_init(&shape->copies);
+        shape->seed = hash_seed_random(shape);
+    }
+
+    shape_table_t table = {0, 0, false};
+    DYN_APPEND(&shape->tables, table);
+    return shape->tables.size;
+}
+
+static shape_entry_t* _shape_get(shape_t* shape, size_t entry)
+{
+    return dyn_array_get(&shape->entries, entry - 1);
+}
+
+static uint64_t _shape_hash(shape_t* shape, size_t table, const char* key, size_t len)
+{
+    return hash_bytes(&shape->seed, key, len) ^ (uint64_t)table * 0x9E3779B97F4A7C15ull;
+}
+
+// Returns the slot the key has in table, or the empty one it would go in
+static shape_slot_t* _shape_slot(shape_t* shape, size_t table, const char* key, size_t len, uint64_t hash)
+{
+    size_t i = (size_t)hash & shape->mask;
+    while (shape->slots[i].entry != 0)
+    {
+        if (shape->slots[i].hash == hash)
+        {
+            const shape_entry_t* entry = _shape_get(shape, shape->slots[i].entry);
+            if (entry->table == table && entry->key_len == len && memcmp(entry->key, key, len) == 0)
+            {
+                break;
+            }
+        }
+        i = (i + 1) & shape->mask;
+    }
+    return &shape->slots[i];
+}
+
+static void _shape_grow(shape_t* shape)
+{
+    size_t old_count = shape->slots != NULL ? shape->mask + 1 : 0;
+    shape_slot_t* old_slots = shape->slots;
+
+    size_t count = old_count != 0 ? old_count * 2 : SHAPE_MIN_SLOTS;
+    shape->slots = ako_malloc(count * sizeof(shape_slot_t));
+    memset(shape->slots, 0, count * sizeof(shape_slot_t));
+    shape->mask = count - 1;
+
+    for (size_t i = 0; i < old_count; ++i)
+    {
+        if (old_slots[i].entry == 0)
+        {
+            continue;
+        }
+
+        size_t slot = (size_t)old_slots[i].hash & shape->mask;
+        while (shape->slots[slot].entry != 0)
+        {
+            slot = (slot + 1) & shape->mask;
+        }
+        shape->slots[slot] = old_slots[i];
+    }
+    if (old_slots != NULL)
+    {
+        ako_free(old_slots);
+    }
+}
+
+// Puts an entry in the hash, unless its table already has one for the key
+static void _shape_index(shape_t* shape, size_t index)
+{
+    // Stays at most half full so probes stay short
+    if (shape->slots == NULL || (shape->used + 1) * 2 > shape->mask + 1)
+    {
+        _shape_grow(shape);
+    }
+
+    const shape_entry_t* entry = _shape_get(shape, index);
+    uint64_t hash = _shape_hash(shape, entry->table, entry->key, entry->key_len);
+    shape_slot_t* slot = _shape_slot(shape, entry->table, entry->key, entry->key_len, hash);
+    if (slot->entry == 0)
+    {
+        slot->entry = index;
+        slot->hash = hash;
+        shape->used++;
+    }
+}
+
+// Returns the first entry for the key in an indexed table, or NULL
+static shape_entry_t* _shape_lookup(shape_t* shape, size_t table, const char* key, size_t len)
+{
+    if (shape->slots == NULL)
+    {
+        return NULL;
+    }
+    shape_slot_t* slot = _shape_slot(shape, table, key, len, _shape_hash(shape, table, key, len));
+    return slot->entry != 0 ? _shape_get(shape, slot->entry) : NULL;
+}
+
+static shape_entry_t* _shape_append(state_t* state, size_t table, const token_t* token, const char* key, size_t len)
+{
+    shape_t* shape = &state->shape;
+    if (token->value_string.escaped)
+    {
+        // Decoded into scratch, which gets reused for the next key
+        char* copy = arena_alloc(&shape->copies, len);
+        memcpy(copy, key, len);
+        key = copy;
+    }
+
+    shape_entry_t entry = {key, len, table, SHAPE_NOT_TABLE, 0};
+    DYN_APPEND(&shape->entries, entry);
+    size_t index = shape->entries.size;
+    shape_table_t* t = dyn_array_get(&shape->tables, table - 1);
+    if (t->last != 0)
+    {
+        _shape_get(shape, t->last)->next = index;
+    }
+    else
+    {
+        t->first = index;
+    }
+    t->last = index;
+    if (t->indexed)
+    {
+        _shape_index(shape, index);
+    }
+    return _shape_get(shape, index);
+}
+
+// Adds an entry for the key in token. Returns it, or NULL if it's known the table already has the key, only the first
+// entry for a key counts, same as ako_elem_table_get_n. The entry is only good until the next call.
+static shape_entry_t* _shape_add(state_t* state, size_t table, const token_t* token)
 {
-    if (state->index + offset >= state->tokens->size)
+    size_t len;
+    const char* key = token_string(state->source, token, &state->scratch, &len);
+    const shape_table_t* t = dyn_array_get(&state->shape.tables, table - 1);
+    if (t->indexed && _shape_lookup(&state->shape, table, key, len) != NULL)
     {
         return NULL;
     }
+    return _shape_append(state, table, token, key, len);
+}
+
+// Dotted keys, finds the first entry for the key in token or adds one if there isn't any
+static shape_entry_t* _shape_find(state_t* state, size_t table, const token_t* token, bool* added)
+{
+    shape_t* shape = &state->shape;
+    shape_table_t* t = dyn_array_get(&shape->tables, table - 1);
+    if (!t->indexed)
+    {
+        t->indexed = true;
+        for (size_t i = t->first; i != 0; i = _shape_get(shape, i)->next)
+        {
+            _shape_index(shape, i);
+        }
+    }
+
+    size_t len;
+    const char* key = token_string(state->source, token, &state->scratch, &len);
+    shape_entry_t* entry = _shape_lookup(shape, table, key, len);
+    *added = entry == NULL;
+    return entry != NULL ? entry : _shape_append(state, table, token, key, len);
+}
+
+static ako_elem_t* _create(state_t* state, ako_type_t type)
+{
+    return ako_elem_create_in(state->doc, type);
+}
+
+// Values are filled in where they already sit in their table or array, see ako_elem_table_emplace_n
+
+static void _set_string(state_t* state, ako_elem_t* elem, const token_t* token)
+{
+    // Decode straight into the string the element will own
+    char* str = ako_doc_alloc(state->doc, token->value_string.length + 1);
+    size_t len = token_copy_string(state->source, token, str);
+    str[len] = '\0';
+
+    ako_elem_set_type(elem, AT_STRING);
+    elem->str = str;
+}
+
+static void _set_table(state_t* state, ako_elem_t* elem)
+{
+    ako_elem_set_type(elem, AT_TABLE);
+    if (state->doc == NULL)
+    {
+        // Tables in a document already share its keys
+        ako_elem_table_share_keys(elem, state->keys);
+    }
+}
+
+static void _set_number(ako_elem_t* elem, const token_t* token)
+{
+    if (token->type == AKO_TT_INT)
+    {
+        ako_elem_set_int(elem, token->value_int);
+    }
+    else
+    {
+        ako_elem_set_float(elem, token->value_float);
+    }
+}
 
-    return dyn_array_get(state->tokens, state->index + offset);
+// Arrays stay packed for as long as every number in them is the same kind
+static bool _pack_number(ako_elem_t* array, const token_t* token)
+{
+    if (token->type == AKO_TT_INT)
+    {
+        return ako_elem_array_pack_int(array, token->value_int);
+    }
+    return ako_elem_array_pack_float(array, token->value_float);
 }
 
 static bool __check_peek_type(state_t* state, size_t offset, token_type_t type)
@@ -49,38 +453,180 @@ static bool __check_peek_type(state_t* state, size_t offset, token_type_t type)
 
 #define CHECK_TYPE(token, checktype) (token != NULL && token->type == checktype)
 
-static ako_elem_t* _parse_array(state_t* state);
-static ako_elem_t* _parse_table(state_t* state, bool should_ignore_braces);
-static ako_elem_t* _parse_value(state_t* state);
+typedef enum
+{
+    FRAME_ROOT, // Table without braces, runs until the end of the source
+    FRAME_TABLE,
+    FRAME_ARRAY,
+} frame_kind_t;
+
+// A table or array we're part way through filling in
+typedef struct
+{
+    ako_elem_t* elem;
+    frame_kind_t kind;
+    size_t select; // Node in state->select the container is at, or SELECT_ALL
+    size_t shape;  // Events mode, number of the table in state->shape
+} frame_t;
+
+// Returns an error if opening one more container would go past max_depth
+static ako_elem_t* _push_frame(state_t* state, ako_elem_t* elem, frame_kind_t kind, size_t offset, size_t select,
+                               size_t shape)
+{
+    if (state->base_depth + state->frames.size >= state->max_depth)
+    {
+        location_t loc = _location(state, offset);
+        return ako_elem_create_errorf("Nested deeper than the max depth of %zu at %zu:%zu", state->max_depth,
+                                      loc.line, loc.column);
+    }
+
+    frame_t frame = {elem, kind, select, shape};
+    DYN_APPEND(&state->frames, frame);
+    return NULL;
+}
+
+// Gets past the rest of a table or array whose opening bracket was just consumed, depth is how many brackets
+// are open. Only brackets are matched, see lexer_skip_brackets. end is set to just past the last one.
+static bool _skip_brackets(state_t* state, size_t depth, size_t* end)
+{
+    // Tokens already pulled out of the lexer come first
+    while (depth > 0 && (state->count > 0 || state->tokens != NULL))
+    {
+        token_t* token = _consume(state);
+        if (token == NULL)
+        {
+            return false;
+        }
+
+        *end = token->end;
+        switch (token->type)
+        {
+        case AKO_TT_OPEN_BRACE:
+            depth++;
+            break;
+        case AKO_TT_OPEN_D_BRACE:
+            depth += 2;
+            break;
+        case AKO_TT_CLOSE_BRACE:
+            depth--;
+            break;
+        case AKO_TT_CLOSE_D_BRACE:
+            depth = depth > 2 ? depth - 2 : 0;
+            break;
+        default:
+            break;
+        }
+    }
+    if (depth == 0)
+    {
+        return true;
+    }
+
+    bool closed = lexer_skip_brackets(&state->lexer, depth);
+    *end = state->lexer.base + state->lexer.index;
+    return closed;
+}
+
+// Lazy mode, notes where a nested table or array is so it can be parsed the first time it's looked at.
+// start is where its opening bracket is, which has already been consumed.
+static ako_elem_t* _set_lazy(state_t* state, ako_elem_t* out, bool is_table, size_t start)
+{
+    size_t end;
+    if (!_skip_brackets(state, is_table ? 1 : 2, &end))
+    {
+        return ako_elem_create_error(is_table ? "Expected a closing brace." : "Expected a closing double brace.");
+    }
+
+    if (is_table)
+    {
+        _set_table(state, out);
+    }
+    else
+    {
+        ako_elem_set_type(out, AT_ARRAY);
+    }
+    out->flags |= ELEM_LAZY;
+    out->lazy.start = start;
+    out->lazy.end = end;
+    out->lazy.depth = state->base_depth + state->frames.size;
+    return NULL;
+}
 
-static ako_elem_t* _parse_value(state_t* state)
+// Parses a value into out, which is already in its parent. Returns an error or NULL.
+// Tables and arrays are only opened here, they get pushed onto the frame stack and the main loop in
+// _parse_root fills them in. On an error out might be left half done, the whole tree gets destroyed anyway.
+// out is NULL when parsing events, the value goes to the handler instead.
+// select is passed on to the table or array if the value is one.
+static ako_elem_t* _parse_value(state_t* state, ako_elem_t* out, size_t select)
 {
     token_t* peeked = peek(state, 0);
+    size_t start_offset;
     location_t start_loc;
+    location_t end_loc;
     dyn_string_t str; // Used in short type
-    ako_elem_t* ret;
+    if (peeked == NULL)
+    {
+        return ako_elem_create_error("Unexpected end of value.");
+    }
+
     switch (peeked->type)
     {
     case AKO_TT_OPEN_D_BRACE:
-        return _parse_array(state);
-    case AKO_TT_OPEN_BRACE:
-        return _parse_table(state, false);
+    case AKO_TT_OPEN_BRACE: {
+        start_offset = peeked->start;
+        _consume(state);
+        bool is_table = peeked->type == AKO_TT_OPEN_BRACE;
+        if (state->events)
+        {
+            bool keep_going = is_table ? state->handler.on_table_begin(state->ud)
+                                       : state->handler.on_array_begin(state->ud);
+            if (!keep_going)
+            {
+                return _stopped(state, start_offset);
+            }
+        }
+        else if (state->lazy && state->frames.size > 0)
+        {
+            return _set_lazy(state, out, is_table, start_offset);
+        }
+        else if (is_table)
+        {
+            _set_table(state, out);
+        }
+        else
+        {
+            ako_elem_set_type(out, AT_ARRAY);
+        }
+        size_t shape = state->events && is_table ? _shape_table(state) : SHAPE_NOT_TABLE;
+        return _push_frame(state, out, is_table ? FRAME_TABLE : FRAME_ARRAY, start_offset, select, shape);
+    }
     case AKO_TT_SEMICOLON:
         _consume(state);
-        return ako_elem_create(AT_NULL);
+        if (state->events)
+        {
+            return state->handler.on_null(state->ud) ? NULL : _stopped(state, peeked->start);
+        }
+        ako_elem_set_null(out);
+        return NULL;
     case AKO_TT_BOOL:
-        _consume(state);
-        return ako_elem_create_bool(peeked->value_int);
     case AKO_TT_PLUS:
     case AKO_TT_MINUS:
         _consume(state);
-        return ako_elem_create_bool(peeked->value_int);
+        if (state->events)
+        {
+            return state->handler.on_bool(state->ud, peeked->value_int != 0) ? NULL : _stopped(state, peeked->start);
+        }
+        ako_elem_set_bool(out, peeked->value_int != 0);
+        return NULL;
     case AKO_TT_INT:
     case AKO_TT_FLOAT:
-        start_loc = peeked->start;
+        start_offset = peeked->start;
         if (CHECK_TYPE(peek(state, 1), AKO_TT_VECTORCROSS))
         {
-            ako_elem_t* array = ako_elem_create(AT_ARRAY);
+            // Collected here and stored right in the element, vectors never need any allocations
+            elem_number_t numbers[4];
+            uint8_t floats = 0;
+            size_t length = 0;
             // we can override peeked at this point since we will either error out or return the array
             while (peek(state, 0) != NULL)
             {
@@ -88,22 +634,27 @@ static ako_elem_t* _parse_value(state_t* state)
                 bool is_int_float = (peeked->type == AKO_TT_INT || peeked->type == AKO_TT_FLOAT);
                 if (!is_int_float)
                 {
+                    start_loc = _location(state, start_offset);
                     return ako_elem_create_errorf("Trying to use non vector type in vector at %zu:%zu", start_loc.line,
                                                   start_loc.column);
                 }
 
                 peeked = _consume(state);
-                ako_elem_t* elem = NULL;
-                if (peeked->type == AKO_TT_INT)
-                {
-                    elem = ako_elem_create_int(peeked->value_int);
-                }
-                else
+                if (length < 4)
                 {
-                    elem = ako_elem_create_float(peeked->value_float);
+                    // Anything past 4 is only counted, it's an error once the end is found
+                    if (peeked->type == AKO_TT_INT)
+                    {
+                        numbers[length].i = peeked->value_int;
+                    }
+                    else
+                    {
+                        numbers[length].f = peeked->value_float;
+                        floats |= (uint8_t)(1 << length);
+                    }
                 }
+                length++;
 
-                ako_elem_array_add(array, elem);
                 peeked = peek(state, 0);
                 if (CHECK_TYPE(peeked, AKO_TT_VECTORCROSS))
                 {
@@ -113,44 +664,70 @@ static ako_elem_t* _parse_value(state_t* state)
                 else
                 {
                     // No continue to vector, return
-                    if (ako_elem_array_get_length(array) > 4)
+                    if (length > 4)
                     {
+                        start_loc = _location(state, start_offset);
                         return ako_elem_create_errorf("Vector size is greater than 4 at %zu:%zu", start_loc.line,
                                                       start_loc.column);
                     }
-                    return array;
+                    if (state->events)
+                    {
+                        return _emit_vector(state, numbers, length, floats, start_offset);
+                    }
+                    ako_elem_set_vector(out, numbers, length, floats);
+                    return NULL;
                 }
             }
+
+            return ako_elem_create_error("Unexpected end of vector.");
         }
 
         _consume(state);
-        if (peeked->type == AKO_TT_INT)
-        {
-            return ako_elem_create_int(peeked->value_int);
-        }
-        else
+        if (state->events)
         {
-            return ako_elem_create_float(peeked->value_float);
+            return _emit_number(state, peeked);
         }
+        _set_number(out, peeked);
+        return NULL;
     case AKO_TT_STRING:
         _consume(state);
-        return ako_elem_create_string(peeked->value_string);
+        if (state->events)
+        {
+            size_t len;
+            const char* value = token_string(state->source, peeked, &state->scratch, &len);
+            return state->handler.on_string(state->ud, value, len) ? NULL : _stopped(state, peeked->start);
+        }
+        _set_string(state, out, peeked);
+        return NULL;
     case AKO_TT_AND:
+        start_offset = peeked->start;
         // need identifier next
         if (!CHECK_TYPE(peek(state, 1), AKO_TT_IDENT))
         {
             // Invalid start
+            start_loc = _location(state, peeked->start);
             return ako_elem_create_errorf("ShortType needs to start with an Identifier, error at %zu:%zu",
-                                          peeked->start.line, peeked->start.column);
+                                          start_loc.line, start_loc.column);
         }
 
         _consume(state);
         peeked = peek(state, 0);
-        str = dyn_string_create(strlen(peeked->value_string));
+        // Heap elements take the built string as is, everything else only needs it for a moment
+        bool keep_str = state->doc == NULL && !state->events;
+        if (keep_str)
+        {
+            str = dyn_string_create(peeked->value_string.length + 1);
+        }
+        else
+        {
+            str = state->scratch;
+            str.size = 0;
+        }
 
         while (CHECK_TYPE(peek(state, 0), AKO_TT_IDENT))
         {
-            dyn_string_append(&str, _consume(state)->value_string);
+            peeked = _consume(state);
+            dyn_string_append_n(&str, state->source + peeked->value_string.offset, peeked->value_string.length);
             peeked = peek(state, 0);
             if (peeked == NULL || peeked->type != AKO_TT_DOT)
             {
@@ -161,39 +738,113 @@ static ako_elem_t* _parse_value(state_t* state)
             dyn_string_append(&str, ".");
         }
 
-        ret = ako_elem_create_shorttype(str.data);
-        ako_free(str.data);
-        return ret;
-    default:
-        return ako_elem_create_errorf("Unsupported type at %zu:%zu -> %zu:%zu", peeked->start.line,
-                                      peeked->start.column, peeked->end.line, peeked->end.column);
-    }
+        if (!keep_str)
+        {
+            // Might have grown
+            state->scratch = str;
+        }
 
-    return ako_elem_create_errorf("Unexpected escape from switch statement.");
+        if (state->events)
+        {
+            return state->handler.on_shorttype(state->ud, str.data, str.size) ? NULL : _stopped(state, start_offset);
+        }
+
+        ako_elem_set_type(out, AT_SHORTTYPE);
+        if (keep_str)
+        {
+            // Hand the built string straight over instead of copying it again
+            out->str = str.data;
+            return NULL;
+        }
+
+        char* copy = ako_doc_alloc(state->doc, str.size + 1);
+        memcpy(copy, str.data, str.size + 1);
+        out->str = copy;
+        return NULL;
+    default:
+        start_loc = _location(state, peeked->start);
+        end_loc = _location(state, peeked->end);
+        return ako_elem_create_errorf("Unsupported type at %zu:%zu -> %zu:%zu", start_loc.line, start_loc.column,
+                                      end_loc.line, end_loc.column);
+    }
+
+    return ako_elem_create_errorf("Unexpected escape from switch statement.");
 }
 
-static ako_elem_t* _parse_table_element(state_t* state, ako_elem_t* table)
+// Select mode, gets past a value nobody asked for. Tables and arrays only have their brackets matched, anything else
+// goes through the grammar as events that go nowhere.
+static ako_elem_t* _skip_value(state_t* state)
+{
+    token_t* peeked = peek(state, 0);
+    if (CHECK_TYPE(peeked, AKO_TT_OPEN_BRACE) || CHECK_TYPE(peeked, AKO_TT_OPEN_D_BRACE))
+    {
+        bool is_array = peeked->type == AKO_TT_OPEN_D_BRACE;
+        _consume(state);
+        size_t end;
+        if (!_skip_brackets(state, is_array ? 2 : 1, &end))
+        {
+            return ako_elem_create_error(is_array ? "Expected a closing double brace." : "Expected a closing brace.");
+        }
+        return NULL;
+    }
+
+    state->events = true;
+    ako_elem_t* err = _parse_value(state, NULL, SELECT_ALL);
+    state->events = false;
+    return err;
+}
+
+// Select mode, gets past the rest of a dotted key and its value
+static ako_elem_t* _skip_entry(state_t* state, bool has_value_first)
+{
+    while (__check_peek_type(state, 0, AKO_TT_DOT))
+    {
+        _consume(state);
+        if (!__check_peek_type(state, 0, AKO_TT_IDENT) && !__check_peek_type(state, 0, AKO_TT_STRING))
+        {
+            return ako_elem_create_error("Failed to get table id.");
+        }
+        _consume(state);
+    }
+    return has_value_first ? NULL : _skip_value(state);
+}
+
+// select is where table is in state->select, keys that don't lead to a selected path are skipped.
+// shape is the table's number in state->shape when parsing events.
+static ako_elem_t* _parse_table_element(state_t* state, ako_elem_t* table, size_t select, size_t shape)
 {
     assert(state != NULL);
-    assert(table != NULL);
-    assert(table->type == AT_TABLE);
+    assert(state->events || (table != NULL && table->type == AT_TABLE));
 
+    // We need {id, value} or {value, id} pairs
     token_t* peeked = peek(state, 0);
-    if (peeked == NULL)
+    if (peeked == NULL || peek(state, 1) == NULL)
+    {
+        return ako_elem_create_error("Expected two tokens, got zero/one.");
+    }
+
+    bool has_valid_first_token =
+        (peeked->type == AKO_TT_IDENT || peeked->type == AKO_TT_STRING || peeked->type == AKO_TT_PLUS ||
+         peeked->type == AKO_TT_MINUS || peeked->type == AKO_TT_SEMICOLON);
+    if (!has_valid_first_token)
     {
-        return ako_elem_create_error("Unexpected end of table element.");
+        return ako_elem_create_errorf("Expected an identifier, bool or null but got: %s",
+                                      TokenType_Strings[peeked->type]);
     }
 
-    token_t* value_first = NULL;
+    // Copied out since the lookahead slot gets reused while the key is parsed
+    token_t value_first = {0};
+    bool has_value_first = false;
     if (CHECK_TYPE(peeked, AKO_TT_MINUS) || CHECK_TYPE(peeked, AKO_TT_PLUS) || CHECK_TYPE(peeked, AKO_TT_SEMICOLON))
     {
-        value_first = _consume(state);
+        value_first = *_consume(state);
+        has_value_first = true;
     }
 
     // Ensure we have a identifier or string.
     {
         peeked = peek(state, 0);
-        bool is_valid_token = (peeked->type == AKO_TT_IDENT || peeked->type == AKO_TT_STRING);
+        bool is_valid_token = CHECK_TYPE(peeked, AKO_TT_IDENT) || CHECK_TYPE(peeked, AKO_TT_STRING);
         if (!is_valid_token)
         {
             return ako_elem_create_error("Expected an identifier or string.");
@@ -201,19 +852,21 @@ static ako_elem_t* _parse_table_element(state_t* state, ako_elem_t* table)
     }
 
     ako_elem_t* current_table = table;
-    const char* ct_id = NULL;
+    token_t ct_id; // Copied out since the lookahead slot gets reused while the value is parsed
+    bool has_ct_id = false;
 
     while (peek(state, 0) != NULL &&
            (CHECK_TYPE(peek(state, 0), AKO_TT_IDENT) || CHECK_TYPE(peek(state, 0), AKO_TT_STRING)))
     {
-        const char* id = _consume(state)->value_string;
+        token_t* id_token = _consume(state);
         bool still_more = __check_peek_type(state, 0, AKO_TT_DOT);
 
         if (!still_more)
         {
             // At the last identifier
             // We can get the value from the table
-            ct_id = id;
+            ct_id = *id_token;
+            has_ct_id = true;
             /*ct_value = ako_elem_table_get(current_table, id);
             if (ct_value == NULL)
             {
@@ -222,15 +875,62 @@ static ako_elem_t* _parse_table_element(state_t* state, ako_elem_t* table)
             }*/
             break;
         }
+        else if (state->events)
+        {
+            // Dotted keys get one on_key for each part, it's up to the handler to make tables out of them
+            ako_elem_t* err = _emit_key(state, id_token);
+            if (err != NULL)
+            {
+                return err;
+            }
+
+            bool added;
+            shape_entry_t* entry = _shape_find(state, shape, id_token, &added);
+            if (added)
+            {
+                entry->child = _shape_table(state);
+            }
+            else if (entry->child == SHAPE_NOT_TABLE)
+            {
+                location_t loc = _location(state, id_token->start);
+                return ako_elem_create_errorf("%.*s is already set to something that isn't a table at %zu:%zu",
+                                              (int)entry->key_len, entry->key, loc.line, loc.column);
+            }
+            shape = entry->child;
+        }
         else
         {
             // Not the last id
             // see if the id in the table, id not create a new table there
-            ako_elem_t* test = ako_elem_table_get(current_table, id);
+            size_t id_len;
+            const char* id = token_string(state->source, id_token, &state->scratch, &id_len);
+            if (select != SELECT_ALL)
+            {
+                select = select_tree_key(state->select, select, id, id_len);
+                if (select == SELECT_NONE)
+                {
+                    return _skip_entry(state, has_value_first);
+                }
+            }
+
+            ako_elem_t* test = ako_elem_table_get_n(current_table, id, id_len);
+            // Only top level keys can reach into the other pieces
+            bool mark = state->part && state->frames.size == 1;
             if (test == NULL)
             {
-                test = ako_elem_create(AT_TABLE);
-                ako_elem_table_add(current_table, id, test);
+                test = ako_elem_table_emplace_n(current_table, id, id_len, AT_NULL);
+                _set_table(state, test);
+                test->flags |= mark ? ELEM_DOTTED : 0;
+            }
+            else if (test->type != AT_TABLE)
+            {
+                location_t loc = _location(state, id_token->start);
+                return ako_elem_create_errorf("%.*s is already set to something that isn't a table at %zu:%zu",
+                                              (int)id_len, id, loc.line, loc.column);
+            }
+            else if (mark && !(test->flags & ELEM_DOTTED))
+            {
+                test->flags |= ELEM_DOTTED_INTO;
             }
 
             current_table = test;
@@ -243,22 +943,87 @@ static ako_elem_t* _parse_table_element(state_t* state, ako_elem_t* table)
         }
     }
 
-    if (ct_id == NULL)
+    if (!has_ct_id)
     {
         return ako_elem_create_error("Failed to get table id.");
     }
 
-    if (value_first != NULL)
+    if (state->events)
+    {
+        ako_elem_t* err = _emit_key(state, &ct_id);
+        if (err != NULL)
+        {
+            return err;
+        }
+
+        size_t children = state->frames.size;
+        if (has_value_first)
+        {
+            bool keep_going = value_first.type == AKO_TT_SEMICOLON
+                                  ? state->handler.on_null(state->ud)
+                                  : state->handler.on_bool(state->ud, value_first.value_int != 0);
+            err = keep_going ? NULL : _stopped(state, value_first.start);
+        }
+        else
+        {
+            err = _parse_value(state, NULL, SELECT_ALL);
+        }
+        if (err != NULL)
+        {
+            return err;
+        }
+
+        // Added after the value so a table it opened can be tied to the key
+        shape_entry_t* entry = _shape_add(state, shape, &ct_id);
+        const frame_t* child = dyn_array_get(&state->frames, state->frames.size - 1);
+        if (entry != NULL && state->frames.size > children && child->kind == FRAME_TABLE)
+        {
+            entry->child = child->shape;
+        }
+        return NULL;
+    }
+
+    if (select != SELECT_ALL)
+    {
+        size_t id_len;
+        const char* id = token_string(state->source, &ct_id, &state->scratch, &id_len);
+        select = select_tree_key(state->select, select, id, id_len);
+        if (select != SELECT_ALL)
+        {
+            // Only on the way to a selected path, which can only carry on through a table or array
+            bool is_table = !has_value_first && __check_peek_type(state, 0, AKO_TT_OPEN_BRACE);
+            bool is_array = !has_value_first && __check_peek_type(state, 0, AKO_TT_OPEN_D_BRACE);
+            if (select == SELECT_NONE)
+            {
+                return has_value_first ? NULL : _skip_value(state);
+            }
+            if (!(is_table || is_array) || (is_array && !select_tree_wants_array(state->select, select)))
+            {
+                // The path stops here, but the key is still taken so a later duplicate gets passed over the same
+                // way the whole tree would pass over it
+                ako_elem_table_emplace_n(current_table, id, id_len, AT_NULL);
+                return has_value_first ? NULL : _skip_value(state);
+            }
+            if (is_array)
+            {
+                select = SELECT_ALL;
+            }
+        }
+    }
+
+    if (has_value_first)
     {
         // value is first
-        switch (value_first->type)
+        size_t id_len;
+        const char* id = token_string(state->source, &ct_id, &state->scratch, &id_len);
+        switch (value_first.type)
         {
         case AKO_TT_PLUS:
         case AKO_TT_MINUS:
-            ako_elem_table_add(current_table, ct_id, ako_elem_create_bool(value_first->value_int));
+            ako_elem_set_bool(ako_elem_table_emplace_n(current_table, id, id_len, AT_NULL), value_first.value_int != 0);
             break;
         case AKO_TT_SEMICOLON:
-            ako_elem_table_add(current_table, ct_id, ako_elem_create(AT_NULL));
+            ako_elem_table_emplace_n(current_table, id, id_len, AT_NULL);
             break;
         default:
             return ako_elem_create_error("Unknown value type.");
@@ -266,154 +1031,602 @@ static ako_elem_t* _parse_table_element(state_t* state, ako_elem_t* table)
     }
     else
     {
-        ako_elem_t* value = _parse_value(state);
-        if (ako_elem_is_error(value))
+        size_t id_len;
+        const char* id = token_string(state->source, &ct_id, &state->scratch, &id_len);
+        ako_elem_t* err =
+            _parse_value(state, ako_elem_table_emplace_n(current_table, id, id_len, AT_NULL), select);
+        if (err != NULL)
         {
             // Uh oh, just return the error
             // Don't destroy any tables as who ever called this function will destroy the tree anyway.
-            return value;
+            return err;
         }
-
-        ako_elem_table_add(current_table, ct_id, value);
     }
 
     return NULL;
 }
 
-static ako_elem_t* _parse_table(state_t* state, bool should_ignore_braces)
+// Does one thing for the innermost open container: closes it, or parses one entry or value into it.
+// Returns an error or NULL.
+static ako_elem_t* _parse_step(state_t* state)
 {
+    // Copied since opening a child can move the stack
+    frame_t frame = *(frame_t*)dyn_array_get(&state->frames, state->frames.size - 1);
+    ako_elem_t* err = NULL;
     token_t* peeked = peek(state, 0);
-    if (!should_ignore_braces)
+
+    if (frame.kind == FRAME_ARRAY)
     {
-        if (CHECK_TYPE(peeked, AKO_TT_OPEN_BRACE))
+        if (CHECK_TYPE(peeked, AKO_TT_CLOSE_D_BRACE))
+        {
+            _consume(state);
+            state->frames.size--;
+            if (state->events && !state->handler.on_array_end(state->ud))
+            {
+                err = _stopped(state, peeked->start);
+            }
+        }
+        else if (peeked == NULL)
+        {
+            err = ako_elem_create_error("Expected a closing double brace.");
+        }
+        else if (!state->events && (peeked->type == AKO_TT_INT || peeked->type == AKO_TT_FLOAT) &&
+                 !__check_peek_type(state, 1, AKO_TT_VECTORCROSS) && _pack_number(frame.elem, peeked))
         {
+            // Plain number, vectors are arrays of their own
             _consume(state);
         }
         else
         {
-            return ako_elem_create_error("Expected an opening brace.");
+            ako_elem_t* out = state->events ? NULL : ako_elem_array_emplace(frame.elem, AT_NULL);
+            err = _parse_value(state, out, frame.select);
         }
     }
-
-    ako_elem_t* table = ako_elem_create(AT_TABLE);
-    while (peek(state, 0) != NULL && peek(state, 0)->type != AKO_TT_CLOSE_BRACE)
+    else if (peeked == NULL || peeked->type == AKO_TT_CLOSE_BRACE)
     {
-        // We need {id, value} or {value, id} pairs
-        peeked = peek(state, 0);
-        if (peeked == NULL || peek(state, 1) == NULL)
+        if (frame.kind == FRAME_TABLE)
         {
-            return ako_elem_create_error("Expected two tokens, got zero/one.");
+            if (peeked == NULL)
+            {
+                err = ako_elem_create_error("Expected a closing brace.");
+            }
+            else
+            {
+                _consume(state);
+            }
         }
-
-        bool has_valid_first_token =
-            (peeked->type == AKO_TT_IDENT || peeked->type == AKO_TT_STRING || peeked->type == AKO_TT_PLUS ||
-             peeked->type == AKO_TT_MINUS || peeked->type == AKO_TT_SEMICOLON);
-
-        if (!has_valid_first_token)
+        // The root without braces just stops here
+        state->frames.size--;
+        if (err == NULL && state->events && !state->handler.on_table_end(state->ud))
         {
-            ako_elem_destroy(table);
-            return ako_elem_create_errorf("Expected an identifier, bool or null but got: %s",
-                                          TokenType_Strings[peeked->type]);
+            err = peeked != NULL ? _stopped(state, peeked->start)
+                                 : ako_elem_create_error("Stopped by the handler at the end of the source");
         }
+    }
+    else
+    {
+        err = _parse_table_element(state, frame.elem, frame.select, frame.shape);
+    }
+    return err;
+}
 
-        ako_elem_t* err = _parse_table_element(state, table);
+// Fills in open containers until there are only base frames left. Returns an error or NULL.
+// No recursion, containers live on the frame stack so deep documents can't blow the C stack.
+static ako_elem_t* _parse_frames(state_t* state, size_t base)
+{
+    while (state->frames.size > base)
+    {
+        ako_elem_t* err = _parse_step(state);
         if (err != NULL)
         {
-            // Uh oh, just return the error
-            ako_elem_destroy(table);
             return err;
         }
     }
 
-    if (!should_ignore_braces)
+    return NULL;
+}
+
+// Makes the root and pushes it as the first frame, or its value if it's in brackets. root is set even on an error
+// so it can be destroyed. There has to be at least one token.
+static ako_elem_t* _open_root(state_t* state, ako_elem_t** root)
+{
+    token_t* peeked = peek(state, 0);
+    // Stays NULL when parsing events
+    *root = state->events ? NULL : _create(state, AT_NULL);
+    // Selecting starts from the root table, a root array is always kept whole
+    size_t select = state->select != NULL && peeked->type != AKO_TT_OPEN_D_BRACE ? 0 : SELECT_ALL;
+    // Pieces are always the middle of a root table, a bracket here is a mistake for the table to find
+    if (!state->part && (peeked->type == AKO_TT_OPEN_D_BRACE || peeked->type == AKO_TT_OPEN_BRACE))
+    {
+        return _parse_value(state, *root, select);
+    }
+
+    if (state->events)
     {
-        peeked = peek(state, 0);
-        if (CHECK_TYPE(peeked, AKO_TT_CLOSE_BRACE))
+        if (!state->handler.on_table_begin(state->ud))
         {
-            _consume(state);
-            return table;
+            return _stopped(state, peeked->start);
         }
+    }
+    else
+    {
+        _set_table(state, *root);
+    }
+    size_t shape = state->events ? _shape_table(state) : SHAPE_NOT_TABLE;
+    ako_elem_t* err = _push_frame(state, *root, FRAME_ROOT, peeked->start, select, shape);
+    assert(err == NULL); // max_depth is never 0
+    return err;
+}
 
-        return ako_elem_create_error("Expected a closing brace.");
+static ako_elem_t* _parse_root(state_t* state)
+{
+    if (peek(state, 0) == NULL)
+    {
+        // Nothing to parse
+        return NULL;
+    }
+
+    ako_elem_t* root;
+    ako_elem_t* err = _open_root(state, &root);
+    // Whatever is left after the root closes is ignored.
+    if (err == NULL)
+    {
+        err = _parse_frames(state, 0);
     }
-    return table;
+
+    if (err != NULL)
+    {
+        // Uh oh, everything opened so far is already in the tree so this frees it all
+        if (root != NULL)
+        {
+            ako_elem_destroy(root);
+        }
+        return err;
+    }
+
+    return root;
 }
 
-static ako_elem_t* _parse_array(state_t* state)
+static void _state_init_with(state_t* state, const ako_parse_opts_t* opts, ako_doc_t* doc, parse_buffers_t* buffers)
 {
-    token_t* peeked = peek(state, 0);
-    if (CHECK_TYPE(peeked, AKO_TT_OPEN_D_BRACE))
+    memset(state, 0, sizeof(state_t));
+    if (buffers != NULL)
     {
-        _consume(state);
+        state->buffers = buffers;
+        state->frames = buffers->frames;
+        state->scratch = buffers->scratch;
+    }
+    else
+    {
+        state->frames = dyn_array_create(sizeof(frame_t));
+    }
+    state->max_depth = AKO_DEFAULT_MAX_DEPTH;
+    state->doc = doc;
+    if (doc != NULL)
+    {
+        state->keys = doc->keys;
+        intern_pool_retain(state->keys);
     }
     else
     {
-        if (peeked == NULL)
+        state->keys = intern_pool_create();
+    }
+    if (opts != NULL && opts->max_depth != 0)
+    {
+        state->max_depth = opts->max_depth;
+    }
+}
+
+static void _state_init(state_t* state, const ako_parse_opts_t* opts, ako_doc_t* doc)
+{
+    _state_init_with(state, opts, doc, NULL);
+}
+
+static void _state_destroy(state_t* state)
+{
+    // Tables hold their own reference, this only frees it if none got made
+    intern_pool_release(state->keys);
+    if (state->shape.started)
+    {
+        dyn_array_destroy(&state->shape.entries);
+        dyn_array_destroy(&state->shape.tables);
+        arena_destroy(&state->shape.copies);
+        if (state->shape.slots != NULL)
         {
-            return ako_elem_create_error("Unexpected end of array.");
+            ako_free(state->shape.slots);
         }
-        return ako_elem_create_errorf("Open double brace expected at %zu:%zu -> %zu:%zu", peeked->start.line,
-                                      peeked->start.column, peeked->end.line, peeked->end.column);
     }
+    if (state->buffers != NULL)
+    {
+        // Might have grown, so they go back even though they're empty
+        state->frames.size = 0;
+        state->scratch.size = 0;
+        state->buffers->frames = state->frames;
+        state->buffers->scratch = state->scratch;
+        return;
+    }
+
+    dyn_array_destroy(&state->frames);
+    if (state->scratch.data != NULL)
+    {
+        ako_free(state->scratch.data);
+    }
+}
 
-    ako_elem_t* array = ako_elem_create(AT_ARRAY);
+// Runs the parser straight off the lexer and cleans up state
+static ako_elem_t* _parse_lexed(state_t* state, const char* source, size_t source_len)
+{
+    line_index_t lines;
+    line_index_init(&lines, source, source_len);
+    lexer_init(&state->lexer, source, source_len, false, &lines);
+    state->source = source;
+    state->lines = &lines;
 
-    while (peek(state, 0) != NULL && peek(state, 0)->type != AKO_TT_CLOSE_D_BRACE)
+    ako_elem_t* result = _parse_root(state);
+    if (state->lexer.err != NULL)
     {
-        ako_elem_t* elem = _parse_value(state);
-        if (elem == NULL)
+        // The lexer failing looks like the end of the source to the parser, so its error wins.
+        if (result != NULL)
         {
-            ako_elem_destroy(array);
-            return ako_elem_create_error("Failed to parse array element.");
+            ako_elem_destroy(result);
         }
+        result = state->lexer.err;
+    }
+
+    line_index_destroy(&lines);
+    _state_destroy(state);
+    return result;
+}
 
-        if (ako_elem_is_error(elem))
+ako_elem_t* ako_parse_source(const char* source, size_t source_len, const ako_parse_opts_t* opts, ako_doc_t* doc)
+{
+    state_t state;
+    _state_init(&state, opts, doc);
+    return _parse_lexed(&state, source, source_len);
+}
+
+void parse_buffers_init(parse_buffers_t* buffers)
+{
+    buffers->frames = dyn_array_create(sizeof(frame_t));
+    memset(&buffers->scratch, 0, sizeof(dyn_string_t));
+}
+
+void parse_buffers_destroy(parse_buffers_t* buffers)
+{
+    dyn_array_destroy(&buffers->frames);
+    if (buffers->scratch.data != NULL)
+    {
+        ako_free(buffers->scratch.data);
+    }
+}
+
+ako_elem_t* ako_parse_source_reuse(const char* source, size_t source_len, const ako_parse_opts_t* opts, ako_doc_t* doc,
+                                   parse_buffers_t* buffers)
+{
+    state_t state;
+    _state_init_with(&state, opts, doc, buffers);
+    return _parse_lexed(&state, source, source_len);
+}
+
+ako_elem_t* ako_parse_source_events(const char* source, size_t source_len, const ako_parse_opts_t* opts,
+                                    const ako_handler_t* handler, void* ud)
+{
+    state_t state;
+    _state_init(&state, opts, NULL);
+    state.events = true;
+    state.handler = *handler;
+    state.ud = ud;
+
+    ako_handler_t* h = &state.handler;
+    h->on_key = h->on_key != NULL ? h->on_key : _skip_string;
+    h->on_table_begin = h->on_table_begin != NULL ? h->on_table_begin : _skip;
+    h->on_table_end = h->on_table_end != NULL ? h->on_table_end : _skip;
+    h->on_array_begin = h->on_array_begin != NULL ? h->on_array_begin : _skip;
+    h->on_array_end = h->on_array_end != NULL ? h->on_array_end : _skip;
+    h->on_null = h->on_null != NULL ? h->on_null : _skip;
+    h->on_bool = h->on_bool != NULL ? h->on_bool : _skip_bool;
+    h->on_int = h->on_int != NULL ? h->on_int : _skip_int;
+    h->on_float = h->on_float != NULL ? h->on_float : _skip_float;
+    h->on_string = h->on_string != NULL ? h->on_string : _skip_string;
+    h->on_shorttype = h->on_shorttype != NULL ? h->on_shorttype : _skip_string;
+    return _parse_lexed(&state, source, source_len);
+}
+
+ako_elem_t* ako_parse_source_part(const char* source, size_t source_len)
+{
+    state_t state;
+    _state_init(&state, NULL, NULL);
+    state.part = true;
+    return _parse_lexed(&state, source, source_len);
+}
+
+ako_elem_t* ako_parse_source_select(const char* source, size_t source_len, const ako_parse_opts_t* opts,
+                                    const select_tree_t* select)
+{
+    if (opts != NULL && opts->check_skipped)
+    {
+        // A dotted key can only clash with a skipped table once everything it could clash with is known, so the
+        // checking is one pass of its own before anything gets built
+        ako_elem_t* err = ako_parse_source_events(source, source_len, opts, &_skip_handler, NULL);
+        if (err != NULL)
         {
-            // Uh oh, just return the error
-            ako_elem_destroy(array);
-            return elem;
+            return err;
         }
-
-        ako_elem_array_add(array, elem);
     }
 
-    peeked = peek(state, 0);
-    if (CHECK_TYPE(peeked, AKO_TT_CLOSE_D_BRACE))
+    state_t state;
+    _state_init(&state, opts, NULL);
+    state.select = select;
+    // Skipped values are parsed as events
+    state.handler = _skip_handler;
+    return _parse_lexed(&state, source, source_len);
+}
+
+ako_elem_t* ako_parse_lazy_root(ako_doc_t* doc)
+{
+    state_t state;
+    _state_init(&state, &doc->opts, doc);
+    state.lazy = true;
+    return _parse_lexed(&state, doc->source, doc->source_len);
+}
+
+ako_elem_t* ako_parse_lazy_container(ako_doc_t* doc, ako_elem_t* container)
+{
+    assert(container->flags & ELEM_LAZY);
+    state_t state;
+    _state_init(&state, &doc->opts, doc);
+    state.lazy = true;
+    state.base_depth = container->lazy.depth;
+    state.source = doc->source;
+    state.lines = &doc->lines;
+    // Ending the lexer at the closing bracket means a broken container can't read into whatever comes after it
+    lexer_init(&state.lexer, doc->source, container->lazy.end, false, &doc->lines);
+    state.lexer.index = container->lazy.start;
+
+    // Back to an empty table or array for the parser to fill in
+    container->flags &= ~ELEM_LAZY;
+    container->blocks = NULL;
+    container->length = 0;
+    container->index = NULL;
+
+    ako_elem_t* err = _parse_value(&state, container, SELECT_ALL);
+    if (err == NULL)
     {
-        _consume(state);
-        return array;
+        err = _parse_frames(&state, 0);
+    }
+    if (state.lexer.err != NULL)
+    {
+        // Same as _parse_lexed, the lexer failing is what stopped the parser
+        if (err != NULL)
+        {
+            ako_elem_destroy(err);
+        }
+        err = state.lexer.err;
     }
 
-    return ako_elem_create_error("Expected a closing double brace.");
+    _state_destroy(&state);
+    return err;
 }
 
-ako_elem_t* ako_parse_tokens(dyn_array_t* tokens)
+struct parse_stream
 {
     state_t state;
-    state.tokens = tokens;
-    state.index = 0;
+    ako_elem_t* root;
+    ako_elem_t* err; // Once set nothing more gets parsed
+    bool started;    // Root has been opened
+};
 
-    token_t* peeked = peek(&state, 0);
-    if (peeked == NULL)
+// Stream mode, gets the token i places on from the current one without pulling it into the lookahead
+static bool _stream_token(state_t* state, size_t i, token_t* out)
+{
+    size_t index = state->token_index - state->count + i;
+    if (index >= state->tokens->tokens.size)
     {
-        return ako_elem_create_error("No tokens to parse");
+        return false;
     }
+    token_buf_get(state->tokens, index, out);
+    return true;
+}
 
-    if (peeked->type == AKO_TT_OPEN_D_BRACE)
+// Stream mode, whether the value i tokens on has all the tokens _parse_value looks at
+static bool _value_ready(state_t* state, size_t i)
+{
+    token_t token;
+    if (!_stream_token(state, i, &token))
     {
-        // array
-        return _parse_array(&state);
+        return false;
     }
-    else
+
+    switch (token.type)
     {
-        bool should_ignore_braces = true;
-        if (peeked->type == AKO_TT_OPEN_BRACE)
+    case AKO_TT_INT:
+    case AKO_TT_FLOAT:
+        // Vectors go on for as long as there's another cross, even a plain number needs to see the next token
+        while (true)
         {
-            should_ignore_braces = false;
+            if (!_stream_token(state, ++i, &token))
+            {
+                return false;
+            }
+            if (token.type != AKO_TT_VECTORCROSS)
+            {
+                return true;
+            }
+            if (!_stream_token(state, ++i, &token))
+            {
+                return false;
+            }
+            if (token.type != AKO_TT_INT && token.type != AKO_TT_FLOAT)
+            {
+                return true;
+            }
         }
+    case AKO_TT_AND:
+        // Same for short types and dots
+        while (true)
+        {
+            if (!_stream_token(state, ++i, &token))
+            {
+                return false;
+            }
+            if (token.type != AKO_TT_IDENT)
+            {
+                return true;
+            }
+            if (!_stream_token(state, ++i, &token))
+            {
+                return false;
+            }
+            if (token.type != AKO_TT_DOT)
+            {
+                return true;
+            }
+        }
+    default:
+        return true;
+    }
+}
 
-        return _parse_table(&state, should_ignore_braces);
+// Stream mode, whether every token the next _parse_step looks at has been lexed. Steps add to the tree as they go
+// and can't be taken back, so one can't start until it's known it won't run out of tokens part way through.
+static bool _step_ready(state_t* state)
+{
+    token_t token;
+    if (!_stream_token(state, 0, &token))
+    {
+        return false;
+    }
+    const frame_t* frame = dyn_array_get(&state->frames, state->frames.size - 1);
+    if (frame->kind == FRAME_ARRAY)
+    {
+        return token.type == AKO_TT_CLOSE_D_BRACE || _value_ready(state, 0);
+    }
+    if (token.type == AKO_TT_CLOSE_BRACE)
+    {
+        return true;
     }
 
-    return NULL;
+    // An entry always looks at two tokens, then a dotted key with the value before or after it
+    token_t second;
+    if (!_stream_token(state, 1, &second))
+    {
+        return false;
+    }
+    size_t i = 0;
+    bool value_first = token.type == AKO_TT_PLUS || token.type == AKO_TT_MINUS || token.type == AKO_TT_SEMICOLON;
+    if (value_first)
+    {
+        token = second;
+        i = 1;
+    }
+    while (token.type == AKO_TT_IDENT || token.type == AKO_TT_STRING)
+    {
+        if (!_stream_token(state, ++i, &token))
+        {
+            return false;
+        }
+        if (token.type != AKO_TT_DOT)
+        {
+            return value_first || _value_ready(state, i);
+        }
+        if (!_stream_token(state, ++i, &token))
+        {
+            return false;
+        }
+    }
+    // Can't be an entry, the step is going to fail on what's already here
+    return true;
+}
+
+parse_stream_t* parse_stream_create(line_index_t* lines)
+{
+    parse_stream_t* ps = ako_malloc(sizeof(parse_stream_t));
+    memset(ps, 0, sizeof(parse_stream_t));
+    _state_init(&ps->state, NULL, NULL);
+    ps->state.lines = lines;
+    return ps;
+}
+
+static void _stream_run(parse_stream_t* ps, const token_buf_t* tokens, const char* strings, bool finished)
+{
+    state_t* state = &ps->state;
+    state->tokens = tokens;
+    state->source = strings;
+    state->token_index = 0;
+    if (ps->err != NULL)
+    {
+        return;
+    }
+
+    if (!ps->started)
+    {
+        if (tokens->tokens.size == 0)
+        {
+            return;
+        }
+        ps->started = true;
+        ps->err = _open_root(state, &ps->root);
+    }
+
+    while (ps->err == NULL && state->frames.size > 0 && (finished || _step_ready(state)))
+    {
+        ps->err = _parse_step(state);
+    }
+}
+
+size_t parse_stream_run(parse_stream_t* ps, const token_buf_t* tokens, const char* strings)
+{
+    _stream_run(ps, tokens, strings, false);
+
+    // Peeked tokens go back, they're still in tokens for next time
+    state_t* state = &ps->state;
+    size_t used = state->token_index - state->count;
+    state->head = 0;
+    state->count = 0;
+    return used;
+}
+
+bool parse_stream_ended(const parse_stream_t* ps)
+{
+    return ps->err != NULL || (ps->started && ps->state.frames.size == 0);
+}
+
+bool parse_stream_failed(const parse_stream_t* ps)
+{
+    return ps->err != NULL;
+}
+
+ako_elem_t* parse_stream_finish(parse_stream_t* ps, const token_buf_t* tokens, const char* strings, ako_elem_t* err)
+{
+    _stream_run(ps, tokens, strings, true);
+    ako_elem_t* result = ps->root;
+    if (ps->err != NULL)
+    {
+        if (result != NULL)
+        {
+            ako_elem_destroy(result);
+        }
+        result = ps->err;
+    }
+
+    if (err != NULL)
+    {
+        // Same as parsing straight from the lexer, its error only counts if the parser got that far.
+        if (!ps->started || ps->state.tokens_ran_out)
+        {
+            if (result != NULL)
+            {
+                ako_elem_destroy(result);
+            }
+            result = err;
+        }
+        else
+        {
+            ako_elem_destroy(err);
+        }
+    }
+
+    _state_destroy(&ps->state);
+    ako_free(ps);
+    return result;
 }
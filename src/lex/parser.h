@@ -2,6 +2,53 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 #include "token.h"
-#include <ako/elem.h>
+#include <ako/ako.h>
 
-ako_elem_t* ako_parse_tokens(dyn_array_t* tokens);
+typedef struct select_tree select_tree_t;
+
+// Tokenizes and parses in one go, tokens are pulled from the lexer as the parser needs them.
+// Returns NULL if the source has nothing in it. opts can be NULL for the defaults.
+// Elements are allocated in doc's arena, or on the heap if doc is NULL. Errors are always on the heap.
+ako_elem_t* ako_parse_source(const char* source, size_t source_len, const ako_parse_opts_t* opts, ako_doc_t* doc);
+// Frames and scratch space for a parse, ako_parser_t keeps them between parses so they don't get allocated again
+typedef struct
+{
+    dyn_array_t frames;
+    dyn_string_t scratch;
+} parse_buffers_t;
+
+void parse_buffers_init(parse_buffers_t* buffers);
+void parse_buffers_destroy(parse_buffers_t* buffers);
+
+// Same as ako_parse_source but uses buffers instead of allocating its own, they're left empty for the next parse.
+ako_elem_t* ako_parse_source_reuse(const char* source, size_t source_len, const ako_parse_opts_t* opts, ako_doc_t* doc,
+                                   parse_buffers_t* buffers);
+// Same as ako_parse_source but calls handler for everything it finds instead of building elements.
+// Returns NULL if it got to the end, otherwise the error that stopped it.
+ako_elem_t* ako_parse_source_events(const char* source, size_t source_len, const ako_parse_opts_t* opts,
+                                    const ako_handler_t* handler, void* ud);
+// Parses a piece of a root table that ako_parse_parallel split off, always as a table even if it starts with a bracket.
+// Tables that top level dotted keys make are flagged ELEM_DOTTED and ones they go into ELEM_DOTTED_INTO, so the pieces
+// can be put back together with ako_elem_table_merge. Returns NULL if the piece has nothing in it.
+ako_elem_t* ako_parse_source_part(const char* source, size_t source_len);
+// Same as ako_parse_source but only builds what's on the way to or under one of the paths in select.
+ako_elem_t* ako_parse_source_select(const char* source, size_t source_len, const ako_parse_opts_t* opts,
+                                    const select_tree_t* select);
+// Parses a lazy document's root, tables and arrays in it are left ELEM_LAZY.
+ako_elem_t* ako_parse_lazy_root(ako_doc_t* doc);
+// Parses an ELEM_LAZY table or array in doc, the ones inside it are left ELEM_LAZY.
+// Returns an error or NULL, on an error the container is left half filled in.
+ako_elem_t* ako_parse_lazy_container(ako_doc_t* doc, ako_elem_t* container);
+// Parser for ako_stream_t, it runs on tokens as they're lexed instead of waiting for the whole document.
+// String and ident tokens point into strings, lines is used to find where tokens are for errors.
+typedef struct parse_stream parse_stream_t;
+parse_stream_t* parse_stream_create(line_index_t* lines);
+// Parses everything in tokens that's known to be complete. Returns how many tokens from the front it's done with,
+// they have to be dropped before the next call and tokens after them added to the end.
+size_t parse_stream_run(parse_stream_t* ps, const token_buf_t* tokens, const char* strings);
+// Hit an error or the root closed, nothing that comes after makes a difference
+bool parse_stream_ended(const parse_stream_t* ps);
+bool parse_stream_failed(const parse_stream_t* ps);
+// Parses the rest of tokens, frees ps and returns the same thing ako_parse would have for the whole document.
+// err is the lexer error that cut the tokens short if there was one, ownership is taken either way.
+ako_elem_t* parse_stream_finish(parse_stream_t* ps, const token_buf_t* tokens, const char* strings, ako_elem_t* err);
@@ -0,0 +1,387 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include "scan.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCAN_X86 1
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_SSE2 1
+#endif
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define SCAN_AVX2 1
+#endif
+#endif
+
+#if SCAN_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SCAN_TARGET_AVX2
+#else
+#define SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Scalar fallbacks, also used to finish off the tail of the SIMD versions.
+
+static size_t scalar_skip_whitespace(const char* data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && (data[i] == ' ' || data[i] == '\n' || data[i] == '\t'))
+    {
+        i++;
+    }
+    return i;
+}
+
+static size_t scalar_find_line_end(const char* data, size_t len)
+{
+    // libc already has a fast version of this
+    const char* found = memchr(data, '\n', len);
+    if (found == NULL)
+    {
+        return len;
+    }
+    return found - data;
+}
+
+static size_t scalar_find_string_special(const char* data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && data[i] != '"' && data[i] != '\\')
+    {
+        i++;
+    }
+    return i;
+}
+
+static size_t scalar_find_skip_special(const char* data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && data[i] != '[' && data[i] != ']' && data[i] != '"' && data[i] != '#')
+    {
+        i++;
+    }
+    return i;
+}
+
+static void scalar_classify_block(const char* data, scan_block_t* out)
+{
+    memset(out, 0, sizeof(scan_block_t));
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        char c = data[i];
+        uint64_t bit = (uint64_t)1 << i;
+        out->open |= c == '[' ? bit : 0;
+        out->close |= c == ']' ? bit : 0;
+        out->quote |= c == '"' ? bit : 0;
+        out->backslash |= c == '\\' ? bit : 0;
+        out->hash |= c == '#' ? bit : 0;
+        out->newline |= c == '\n' ? bit : 0;
+    }
+}
+
+#if SCAN_X86
+static unsigned scan_ctz(unsigned mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+#if SCAN_SSE2
+static size_t sse2_skip_whitespace(const char* data, size_t len)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                                  _mm_cmpeq_epi8(v, tab));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFF;
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_skip_whitespace(data + i, len - i);
+}
+
+static size_t sse2_find_line_end(const char* data, size_t len)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_find_line_end(data + i, len - i);
+}
+
+static size_t sse2_find_string_special(const char* data, size_t len)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_find_string_special(data + i, len - i);
+}
+
+static size_t sse2_find_skip_special(const char* data, size_t len)
+{
+    const __m128i open = _mm_set1_epi8('[');
+    const __m128i close = _mm_set1_epi8(']');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i hash = _mm_set1_epi8('#');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(v, open), _mm_cmpeq_epi8(v, close));
+        __m128i hit = _mm_or_si128(_mm_or_si128(brackets, _mm_cmpeq_epi8(v, quote)), _mm_cmpeq_epi8(v, hash));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_find_skip_special(data + i, len - i);
+}
+
+static void sse2_classify_block(const char* data, scan_block_t* out)
+{
+    const __m128i open = _mm_set1_epi8('[');
+    const __m128i close = _mm_set1_epi8(']');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i hash = _mm_set1_epi8('#');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    memset(out, 0, sizeof(scan_block_t));
+    for (unsigned i = 0; i < 64; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        out->open |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, open)) << i;
+        out->close |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, close)) << i;
+        out->quote |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << i;
+        out->backslash |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)) << i;
+        out->hash |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, hash)) << i;
+        out->newline |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << i;
+    }
+}
+#endif
+
+#if SCAN_AVX2
+SCAN_TARGET_AVX2 static size_t avx2_skip_whitespace(const char* data, size_t len)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, newline)),
+                                     _mm256_cmpeq_epi8(v, tab));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(ws);
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_skip_whitespace(data + i, len - i);
+}
+
+SCAN_TARGET_AVX2 static size_t avx2_find_line_end(const char* data, size_t len)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_find_line_end(data + i, len - i);
+}
+
+SCAN_TARGET_AVX2 static size_t avx2_find_string_special(const char* data, size_t len)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_find_string_special(data + i, len - i);
+}
+
+SCAN_TARGET_AVX2 static size_t avx2_find_skip_special(const char* data, size_t len)
+{
+    const __m256i open = _mm256_set1_epi8('[');
+    const __m256i close = _mm256_set1_epi8(']');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i hash = _mm256_set1_epi8('#');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i brackets = _mm256_or_si256(_mm256_cmpeq_epi8(v, open), _mm256_cmpeq_epi8(v, close));
+        __m256i hit =
+            _mm256_or_si256(_mm256_or_si256(brackets, _mm256_cmpeq_epi8(v, quote)), _mm256_cmpeq_epi8(v, hash));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask != 0)
+        {
+            return i + scan_ctz(mask);
+        }
+    }
+    return i + scalar_find_skip_special(data + i, len - i);
+}
+
+SCAN_TARGET_AVX2 static void avx2_classify_block(const char* data, scan_block_t* out)
+{
+    const __m256i open = _mm256_set1_epi8('[');
+    const __m256i close = _mm256_set1_epi8(']');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i hash = _mm256_set1_epi8('#');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    memset(out, 0, sizeof(scan_block_t));
+    for (unsigned i = 0; i < 64; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        out->open |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, open)) << i;
+        out->close |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, close)) << i;
+        out->quote |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << i;
+        out->backslash |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)) << i;
+        out->hash |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, hash)) << i;
+        out->newline |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)) << i;
+    }
+}
+
+static bool cpu_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // Need both the instructions and the OS saving the ymm registers for us
+    __cpuid(info, 1);
+    bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    bool has_avx = (info[2] & (1 << 28)) != 0;
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static const scan_funcs_t scalar_funcs = {
+    .skip_whitespace = scalar_skip_whitespace,
+    .find_line_end = scalar_find_line_end,
+    .find_string_special = scalar_find_string_special,
+    .find_skip_special = scalar_find_skip_special,
+    .classify_block = scalar_classify_block,
+};
+
+#if SCAN_SSE2
+static const scan_funcs_t sse2_funcs = {
+    .skip_whitespace = sse2_skip_whitespace,
+    .find_line_end = sse2_find_line_end,
+    .find_string_special = sse2_find_string_special,
+    .find_skip_special = sse2_find_skip_special,
+    .classify_block = sse2_classify_block,
+};
+#endif
+
+#if SCAN_AVX2
+static const scan_funcs_t avx2_funcs = {
+    .skip_whitespace = avx2_skip_whitespace,
+    .find_line_end = avx2_find_line_end,
+    .find_string_special = avx2_find_string_special,
+    .find_skip_special = avx2_find_skip_special,
+    .classify_block = avx2_classify_block,
+};
+#endif
+
+const scan_funcs_t* scan_get(void)
+{
+    // Racing threads will all pick the same thing, so no need for anything fancier.
+    static const scan_funcs_t* selected = NULL;
+    if (selected != NULL)
+    {
+        return selected;
+    }
+
+    const scan_funcs_t* funcs = &scalar_funcs;
+#if SCAN_SSE2
+    funcs = &sse2_funcs;
+#endif
+#if SCAN_AVX2
+    if (cpu_has_avx2())
+    {
+        funcs = &avx2_funcs;
+    }
+#endif
+
+    selected = funcs;
+    return selected;
+}
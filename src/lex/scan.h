@@ -0,0 +1,36 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Where the bytes that give a table or array its shape are in a 64 byte block, bit i is byte i
+typedef struct
+{
+    uint64_t open;      // '['
+    uint64_t close;     // ']'
+    uint64_t quote;     // '"'
+    uint64_t backslash; // '\\'
+    uint64_t hash;      // '#'
+    uint64_t newline;   // '\n'
+} scan_block_t;
+
+// Bulk scanning kernels used by the tokenizer to move over whitespace, comments and string bodies
+// without going byte by byte. Each one returns the offset of the first byte it stops at, or len if it
+// ran off the end of the buffer.
+typedef struct
+{
+    // Stops at the first byte that isn't ' ', '\n' or '\t'
+    size_t (*skip_whitespace)(const char* data, size_t len);
+    // Stops at the first '\n'
+    size_t (*find_line_end)(const char* data, size_t len);
+    // Stops at the first '"' or '\\'
+    size_t (*find_string_special)(const char* data, size_t len);
+    // Stops at the first '[', ']', '"' or '#', everything a skipped table or array needs to look at
+    size_t (*find_skip_special)(const char* data, size_t len);
+    // Classifies exactly 64 bytes, see lexer_skip_brackets
+    void (*classify_block)(const char* data, scan_block_t* out);
+} scan_funcs_t;
+
+// Picks the best implementation for the CPU we're running on the first time it's called.
+const scan_funcs_t* scan_get(void);
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 #include "../mem/dyn_array.h"
+#include "../mem/dyn_string.h"
+#include "scan.h"
 #include <ako/types.h>
 
 typedef enum
@@ -51,22 +53,138 @@ typedef struct
     size_t index;
 } location_t;
 
+// Finds the line and column of a byte offset, only used when something goes wrong so nothing is
+// worked out until the first time it's asked for.
+typedef struct
+{
+    const char* source; // Scanned on the first lookup, NULL if the new lines are being added as they come in
+    size_t source_len;
+    dyn_array_t newlines; // Offset of every '\n', sorted
+} line_index_t;
+
+void line_index_init(line_index_t* index, const char* source, size_t source_len);
+// Records the new lines in the next part of the document, base is where data starts in it.
+// Only for indexes made without a source, parts have to be added in order.
+void line_index_add(line_index_t* index, const char* data, size_t len, size_t base);
+location_t line_index_find(line_index_t* index, size_t offset);
+void line_index_destroy(line_index_t* index);
+
 typedef struct
 {
     token_type_t type;
-    location_t start;
-    location_t end;
+    size_t start; // Byte offsets into the document, use line_index_find to get a line and column
+    size_t end;
     union {
-        ako_int value_int;        // BOOL, INT
-        ako_float value_float;    // FLOAT
-        const char* value_string; // STRING, IDENT | This is malloced, please free once done :3
+        ako_int value_int;     // BOOL, INT
+        ako_float value_float; // FLOAT
+        // STRING, IDENT | A view into the source, escapes are left as is and decoded when copied out.
+        // Not NUL terminated, use token_string or token_copy_string to get at the bytes.
+        struct
+        {
+            size_t offset;
+            size_t length;
+            bool escaped;
+        } value_string;
     };
 } token_t;
 
-size_t location_format(const location_t* loc, char* output, size_t output_size);
+// What tokens look like once they're stored, a quarter the size of token_t so long token arrays stay in cache.
+// Offsets are 32 bit, token_buf_t falls back to plain token_t for anything bigger.
+#define TOKEN_PACKED_MAX_SOURCE UINT32_MAX
+
+typedef enum
+{
+    TOKEN_FLAG_ESCAPED = 0x1,      // STRING has escapes in it
+    TOKEN_FLAG_UNTERMINATED = 0x2, // STRING ran into the end of the source without a closing quote
+} token_flags_t;
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t start;  // Byte offset into the document
+    uint32_t length; // How many bytes of the document the token covers, quotes included
+    // STRING, IDENT | Offset of the bytes in the text they were copied to, which is the source unless streaming.
+    // INT, FLOAT    | Index into token_buf_t.values
+    uint32_t payload;
+} packed_token_t;
+
+typedef union {
+    ako_int value_int;
+    ako_float value_float;
+} token_value_t;
+
+typedef struct
+{
+    bool wide;          // Too big for packed tokens, tokens holds token_t
+    dyn_array_t tokens; // packed_token_t, or token_t if wide
+    dyn_array_t values; // Numbers for packed tokens
+} token_buf_t;
+
+void token_buf_init(token_buf_t* buf, bool wide);
+void token_buf_destroy(token_buf_t* buf);
+void token_buf_push(token_buf_t* buf, const token_t* token);
+// Unpacks the token at index into out
+void token_buf_get(const token_buf_t* buf, size_t index, token_t* out);
+// Removes the first count tokens of a wide buffer, the rest move down to fill the gap
+void token_buf_drop(token_buf_t* buf, size_t count);
+
+typedef struct
+{
+    token_buf_t tokens;
+    const char* source;
+} token_list_t;
 
 typedef struct ako_elem ako_elem_t;
 
-// Returns an array of Token_t, please destroy the returned array when finished :)
-dyn_array_t ako_tokenize(const char* source, ako_elem_t** err, bool ignore_floats);
-void ako_free_tokens(dyn_array_t* tokens);
+// Pulls tokens out of the source one at a time, nothing is allocated unless an error is hit.
+typedef struct lexer
+{
+    const char* source;
+    size_t source_len;
+    size_t index;
+    size_t base; // Offset of source in the whole document, only non zero when streaming
+    bool ignore_floats;
+    bool after_number; // Last token was a number, an x right after it is a vector cross
+    bool in_vector;    // Last token was a vector cross, a number has to come next
+    bool in_comment;   // Window ended part way through a comment
+    bool more_coming;  // Source is only a window, more of the document comes after it
+    bool starved;      // Window ran out part way through a token, index is rewound to the start of it
+    const scan_funcs_t* scan;
+
+    size_t meta;         // Where the current token started in the document
+    line_index_t* lines; // Only touched when making an error
+
+    ako_elem_t* err; // Set when lexing fails, the caller owns it. No more tokens are produced after.
+} lexer_t;
+
+void lexer_init(lexer_t* lexer, const char* source, size_t source_len, bool ignore_floats, line_index_t* lines);
+// Returns false when there are no more tokens, check lexer->err to see if that was because of an error.
+// If more_coming is set it can also stop with lexer->starved, the bytes from index onwards need to be given
+// again along with what comes after them.
+bool lexer_next(lexer_t* lexer, token_t* token);
+// Moves the lexer onto the next part of the document, base is where source starts in it.
+// Vector and comment state carry over.
+void lexer_set_window(lexer_t* lexer, const char* source, size_t source_len, size_t base, bool more_coming);
+// Jumps over the rest of a table or array without making any tokens, depth is how many brackets are open.
+// Brackets are only counted, so [ and [[ aren't told apart and nothing in between is checked.
+// Returns false if the source ran out first. Only works on whole sources, not windows.
+bool lexer_skip_brackets(lexer_t* lexer, size_t depth);
+// Same as lexer_skip_brackets but from outside of any brackets, gets past the next table or array that opens.
+// Returns false if the source runs out or a closing bracket shows up before an opening one.
+bool lexer_skip_next_brackets(lexer_t* lexer);
+
+size_t location_format(const location_t* loc, char* output, size_t output_size);
+
+// Copies the bytes of a STRING or IDENT token into out, decoding any escapes.
+// out needs room for token->value_string.length bytes, returns how many were written.
+size_t token_copy_string(const char* source, const token_t* token, char* out);
+// Returns the bytes of a STRING or IDENT token and writes their length to length.
+// Points into the source unless the token has escapes, then it's decoded into scratch.
+const char* token_string(const char* source, const token_t* token, dyn_string_t* scratch, size_t* length);
+
+// Returns a list of Token_t, please free the returned list with ako_free_tokens when finished :)
+// The source doesn't need to be NUL terminated, only source_len bytes are read.
+token_list_t ako_tokenize(const char* source, size_t source_len, ako_elem_t** err, bool ignore_floats);
+void ako_free_tokens(token_list_t* list);
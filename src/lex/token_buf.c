@@ -0,0 +1,133 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include <assert.h>
+#include <string.h>
+
+#include "token.h"
+
+void token_buf_init(token_buf_t* buf, bool wide)
+{
+    memset(buf, 0, sizeof(token_buf_t));
+    buf->wide = wide;
+    buf->tokens = dyn_array_create(wide ? sizeof(token_t) : sizeof(packed_token_t));
+    if (!wide)
+    {
+        buf->values = dyn_array_create(sizeof(token_value_t));
+    }
+}
+
+void token_buf_destroy(token_buf_t* buf)
+{
+    dyn_array_destroy(&buf->tokens);
+    if (buf->values.internal.data != NULL)
+    {
+        dyn_array_destroy(&buf->values);
+    }
+}
+
+void token_buf_push(token_buf_t* buf, const token_t* token)
+{
+    if (buf->wide)
+    {
+        dyn_array_append(&buf->tokens, (void*)token, sizeof(token_t));
+        return;
+    }
+
+    assert(token->end <= TOKEN_PACKED_MAX_SOURCE);
+    packed_token_t packed;
+    memset(&packed, 0, sizeof(packed_token_t));
+    packed.type = (uint8_t)token->type;
+    packed.start = (uint32_t)token->start;
+    packed.length = (uint32_t)(token->end - token->start);
+
+    switch (token->type)
+    {
+    case AKO_TT_STRING:
+        // Quotes aren't part of the string, the closing one might not be there at all
+        assert(packed.length - token->value_string.length == 1 || packed.length - token->value_string.length == 2);
+        if (packed.length - token->value_string.length == 1)
+        {
+            packed.flags |= TOKEN_FLAG_UNTERMINATED;
+        }
+        // fallthrough
+    case AKO_TT_IDENT:
+        if (token->value_string.escaped)
+        {
+            packed.flags |= TOKEN_FLAG_ESCAPED;
+        }
+        packed.payload = (uint32_t)token->value_string.offset;
+        break;
+    case AKO_TT_INT:
+    case AKO_TT_FLOAT:
+    case AKO_TT_BOOL: {
+        token_value_t value;
+        if (token->type == AKO_TT_FLOAT)
+        {
+            value.value_float = token->value_float;
+        }
+        else
+        {
+            value.value_int = token->value_int;
+        }
+        packed.payload = (uint32_t)buf->values.size;
+        DYN_APPEND(&buf->values, value);
+        break;
+    }
+    default:
+        break;
+    }
+
+    DYN_APPEND(&buf->tokens, packed);
+}
+
+void token_buf_get(const token_buf_t* buf, size_t index, token_t* out)
+{
+    assert(index < buf->tokens.size);
+    if (buf->wide)
+    {
+        *out = ((const token_t*)buf->tokens.internal.data)[index];
+        return;
+    }
+
+    const packed_token_t* packed = (const packed_token_t*)buf->tokens.internal.data + index;
+    memset(out, 0, sizeof(token_t));
+    out->type = (token_type_t)packed->type;
+    out->start = packed->start;
+    out->end = (size_t)packed->start + packed->length;
+
+    switch (out->type)
+    {
+    case AKO_TT_STRING:
+        out->value_string.offset = packed->payload;
+        out->value_string.length = packed->length - ((packed->flags & TOKEN_FLAG_UNTERMINATED) ? 1 : 2);
+        out->value_string.escaped = (packed->flags & TOKEN_FLAG_ESCAPED) != 0;
+        break;
+    case AKO_TT_IDENT:
+        out->value_string.offset = packed->payload;
+        out->value_string.length = packed->length;
+        out->value_string.escaped = (packed->flags & TOKEN_FLAG_ESCAPED) != 0;
+        break;
+    case AKO_TT_INT:
+    case AKO_TT_BOOL:
+        out->value_int = ((const token_value_t*)buf->values.internal.data)[packed->payload].value_int;
+        break;
+    case AKO_TT_FLOAT:
+        out->value_float = ((const token_value_t*)buf->values.internal.data)[packed->payload].value_float;
+        break;
+    case AKO_TT_PLUS:
+        // Bools are known from the type alone
+        out->value_int = 1;
+        break;
+    default:
+        break;
+    }
+}
+
+void token_buf_drop(token_buf_t* buf, size_t count)
+{
+    assert(buf->wide);
+    assert(count <= buf->tokens.size);
+    token_t* tokens = buf->tokens.internal.data;
+    memmove(tokens, tokens + count, (buf->tokens.size - count) * sizeof(token_t));
+    buf->tokens.size -= count;
+}
@@ -1,166 +1,243 @@
 // Copyright (c) 2025 Tuyuji, Reece Hagan
 // SPDX-License-Identifier: MIT
 #include <assert.h>
-#include <ctype.h>
-#include <errno.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
 #include "ako/ako.h"
 #include "ako/elem.h"
+#include "number.h"
 #include "token.h"
 
-#if defined(_MSC_VER)
-#include <malloc.h>
-#define alloca _alloca
-#else
-#include <alloca.h>
-#endif
-
-typedef struct state
+static char consume(lexer_t* lexer)
 {
-    dyn_array_t tokens;
-    const char* source;
-    size_t source_len;
-    size_t index;
-    bool ignore_floats;
-
-    location_t meta;
-    location_t current_loc;
-} state_t;
-
-static char consume(state_t* state)
-{
-    if (state->index >= state->source_len)
+    if (lexer->index >= lexer->source_len)
     {
         return '\0';
     }
 
-    char next = state->source[state->index++];
-    if (next == '\n' || next == '\t')
-    {
-        state->current_loc.line++;
-        state->current_loc.column = 0;
-    }
+    return lexer->source[lexer->index++];
+}
 
-    state->current_loc.column++;
-    state->current_loc.index = state->index;
-    return next;
+// Moves forward count bytes in one go, lines are only worked out if an error needs them
+static void advance(lexer_t* lexer, size_t count)
+{
+    assert(lexer->index + count <= lexer->source_len);
+    lexer->index += count;
 }
 
-static bool has_value(state_t* state, size_t offset)
+static bool has_value(lexer_t* lexer, size_t offset)
 {
-    if (state->index + offset >= state->source_len)
+    if (lexer->index + offset >= lexer->source_len)
     {
         return false;
     }
     return true;
 }
 
-static char peek(state_t* state, size_t offset)
+static char peek(lexer_t* lexer, size_t offset)
 {
-    if (!has_value(state, offset))
+    if (!has_value(lexer, offset))
     {
         // cant peek what doesnt exist.
         assert(false);
     }
 
-    return state->source[state->index + offset];
+    return lexer->source[lexer->index + offset];
+}
+
+static void start_meta(lexer_t* lexer)
+{
+    lexer->meta = lexer->base + lexer->index;
+}
+
+static void finish_token(lexer_t* lexer, token_t* token)
+{
+    token->start = lexer->meta;
+    token->end = lexer->base + lexer->index;
 }
 
-static void start_meta(state_t* state)
+// True if a token that reached the end of the window might carry on in the next one
+static bool window_ended(lexer_t* lexer, size_t offset)
 {
-    state->meta = state->current_loc;
+    return lexer->more_coming && !has_value(lexer, offset);
 }
 
-static void add_token(state_t* state, token_t token)
+// Gives up on the current token until more of the document shows up
+static bool starve(lexer_t* lexer)
 {
-    token.start = state->meta;
-    token.end = state->current_loc;
-    DYN_APPEND(&state->tokens, token);
+    lexer->index = lexer->meta - lexer->base;
+    lexer->starved = true;
+    return false;
 }
 
-static bool is_valid_id(char in)
+typedef enum
 {
-    return isalpha(in) || in == '_';
+    CHAR_NONE,  // Not valid anywhere outside of strings and comments
+    CHAR_SPACE, // ' ', '\t', '\n'
+    CHAR_HASH,  // Comment start
+    CHAR_PUNCT, // + - ; . & [ ]
+    CHAR_IDENT, // Letters, '_' and anything non ASCII
+    CHAR_DIGIT,
+    CHAR_QUOTE,
+    CHAR_CLASS_MAX
+} char_class_t;
+
+// clang-format off
+// What every byte can start, one lookup instead of a chain of compares.
+// Anything from 0x80 up is part of a UTF-8 sequence and treated as an identifier.
+static const uint8_t char_class[256] = {
+    CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, // 0x00
+    CHAR_NONE, CHAR_SPACE, CHAR_SPACE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, // 0x08
+    CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, // 0x10
+    CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, // 0x18
+    CHAR_SPACE, CHAR_NONE, CHAR_QUOTE, CHAR_HASH, CHAR_NONE, CHAR_NONE, CHAR_PUNCT, CHAR_NONE, // 0x20
+    CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_PUNCT, CHAR_NONE, CHAR_PUNCT, CHAR_PUNCT, CHAR_NONE, // 0x28
+    CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, // 0x30
+    CHAR_DIGIT, CHAR_DIGIT, CHAR_NONE, CHAR_PUNCT, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, // 0x38
+    CHAR_NONE, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x40
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x48
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x50
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_PUNCT, CHAR_NONE, CHAR_PUNCT, CHAR_NONE, CHAR_IDENT, // 0x58
+    CHAR_NONE, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x60
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x68
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x70
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, CHAR_NONE, // 0x78
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x80
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x88
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x90
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0x98
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xA0
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xA8
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xB0
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xB8
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xC0
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xC8
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xD0
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xD8
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xE0
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xE8
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xF0
+    CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, CHAR_IDENT, // 0xF8
+};
+// clang-format on
+
+static char_class_t get_class(char c)
+{
+    return (char_class_t)char_class[(unsigned char)c];
 }
 
-static size_t count_id(state_t* state)
+static size_t count_id(lexer_t* lexer)
 {
-    size_t offset = 0;
-    while (has_value(state, offset))
+    const char* iter = lexer->source + lexer->index;
+    const char* end = lexer->source + lexer->source_len;
+    const char* start = iter;
+    while (iter < end)
     {
-        char c = peek(state, offset);
-        if (isalnum(c) || c == '_')
-        {
-            // good id!
-            offset++;
-        }
-        else
+        char_class_t kind = get_class(*iter);
+        if (kind != CHAR_IDENT && kind != CHAR_DIGIT)
         {
             break;
         }
+        iter++;
     }
-    return offset;
+    return iter - start;
 }
 
-static size_t count_number(state_t* state)
+static size_t count_number(lexer_t* lexer)
 {
-    size_t offset = 0;
-    while (has_value(state, offset))
+    const char* iter = lexer->source + lexer->index;
+    const char* end = lexer->source + lexer->source_len;
+    const char* start = iter;
+    while (iter < end)
     {
-        char c = peek(state, offset);
-        if (state->ignore_floats && c == '.')
+        if (*iter == '.')
         {
-            // Ignoring floats and found a dot, were done :)
-            break;
-        }
-        if (isdigit(c) || c == '.')
-        {
-            // good number!
-            offset++;
+            if (lexer->ignore_floats)
+            {
+                // Ignoring floats and found a dot, were done :)
+                break;
+            }
         }
-        else
+        else if (get_class(*iter) != CHAR_DIGIT)
         {
             break;
         }
+        iter++;
     }
-    return offset;
+    return iter - start;
 }
 
-// Assumes the current offset is already in the starting quote
-// Should be here when executing this function:
-//  "Hello, World"
-//	^
-static size_t count_string(state_t* state)
+void line_index_init(line_index_t* index, const char* source, size_t source_len)
 {
-    size_t offset = 0;
-    while (has_value(state, offset))
+    memset(index, 0, sizeof(line_index_t));
+    index->source = source;
+    index->source_len = source_len;
+}
+
+void line_index_add(line_index_t* index, const char* data, size_t len, size_t base)
+{
+    assert(index->source == NULL);
+    if (index->newlines.internal.data == NULL)
     {
-        char c = peek(state, offset);
-        // anything is allowed pretty much other than real new lines
-        if (c == '\n' || c == '\t')
+        index->newlines = dyn_array_create(sizeof(size_t));
+    }
+
+    const char* iter = data;
+    const char* end = data + len;
+    const char* newline;
+    while ((newline = memchr(iter, '\n', end - iter)) != NULL)
+    {
+        size_t offset = base + (newline - data);
+        DYN_APPEND(&index->newlines, offset);
+        iter = newline + 1;
+    }
+}
+
+location_t line_index_find(line_index_t* index, size_t offset)
+{
+    if (index->source != NULL && index->newlines.internal.data == NULL)
+    {
+        // First time anyone has needed a line, go find them all
+        const char* source = index->source;
+        index->source = NULL;
+        line_index_add(index, source, index->source_len, 0);
+    }
+
+    // How many new lines come before offset
+    size_t low = 0;
+    size_t high = index->newlines.size;
+    const size_t* newlines = index->newlines.internal.data;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (newlines[mid] < offset)
         {
-            // ignore REAL new lines
-            continue;
+            low = mid + 1;
         }
-        // process escapes
-        if (c == '\\')
+        else
         {
-            offset++;
-            offset++;
+            high = mid;
         }
+    }
 
-        if (c == '"')
-        {
-            break;
-        }
+    location_t loc;
+    loc.line = low + 1;
+    loc.column = offset - (low == 0 ? 0 : newlines[low - 1] + 1) + 1;
+    loc.index = offset;
+    return loc;
+}
 
-        offset++;
+void line_index_destroy(line_index_t* index)
+{
+    if (index->newlines.internal.data != NULL)
+    {
+        dyn_array_destroy(&index->newlines);
     }
-
-    return offset;
 }
 
 size_t location_format(const location_t* loc, char* output, size_t output_size)
@@ -184,276 +261,644 @@ size_t location_format(const location_t* loc, char* output, size_t output_size)
     return written;
 }
 
-static bool parse_digit(state_t* state, ako_elem_t** err)
+size_t token_copy_string(const char* source, const token_t* token, char* out)
 {
-    *err = NULL;
-    token_t token;
-    bool is_floating = false;
-    size_t num_size = count_number(state);
-    if (num_size == 0)
+    assert(token->type == AKO_TT_STRING || token->type == AKO_TT_IDENT);
+    const char* iter = source + token->value_string.offset;
+    size_t length = token->value_string.length;
+    if (!token->value_string.escaped)
     {
-        return false;
+        memcpy(out, iter, length);
+        return length;
     }
 
-    size_t num_bytesize = sizeof(char) * num_size + 1;
-    char* num = alloca(num_bytesize);
-    memset(num, '\0', num_bytesize);
-    for (size_t i = 0; i < num_size; ++i)
+    // Copy the runs between escapes in bulk, we already know where the string ends so no need to look for quotes.
+    const char* end = iter + length;
+    char* written = out;
+    while (iter < end)
     {
-        num[i] = consume(state);
-        if (num[i] == '.' && !is_floating)
+        const char* escape = memchr(iter, '\\', end - iter);
+        if (escape == NULL)
         {
-            is_floating = true;
+            escape = end;
+        }
+        memcpy(written, iter, escape - iter);
+        written += escape - iter;
+        iter = escape;
+        if (iter + 1 >= end)
+        {
+            // Nothing after the escape, drop it
+            break;
         }
+
+        switch (iter[1])
+        {
+        case 'n':
+            *written = '\n';
+            break;
+        case 't':
+            *written = '\t';
+            break;
+        default:
+            *written = iter[1];
+            break;
+        }
+        written++;
+        iter += 2;
+    }
+    return written - out;
+}
+
+const char* token_string(const char* source, const token_t* token, dyn_string_t* scratch, size_t* length)
+{
+    assert(token->type == AKO_TT_STRING || token->type == AKO_TT_IDENT);
+    if (!token->value_string.escaped)
+    {
+        *length = token->value_string.length;
+        return source + token->value_string.offset;
+    }
+
+    // Escapes only ever make the string shorter
+    dyn_string_reserve(scratch, token->value_string.length + 1);
+    *length = token_copy_string(source, token, scratch->data);
+    scratch->size = *length;
+    scratch->data[*length] = '\0';
+    return scratch->data;
+}
+
+static bool parse_digit(lexer_t* lexer, token_t* token)
+{
+    size_t num_size = count_number(lexer);
+    if (window_ended(lexer, num_size))
+    {
+        return starve(lexer);
+    }
+    if (num_size == 0)
+    {
+        return false;
     }
-    char* numerr = NULL;
-    errno = 0;
-    if (is_floating)
+
+    // Parse straight out of the source, count_number already made sure its only digits and dots
+    const char* num = lexer->source + lexer->index;
+    bool ok;
+    if (memchr(num, '.', num_size) != NULL)
     {
-        token.type = AKO_TT_FLOAT;
-        token.value_float = strtod(num, &numerr);
+        token->type = AKO_TT_FLOAT;
+        ok = number_parse_float(num, num_size, &token->value_float);
     }
     else
     {
-        token.type = AKO_TT_INT;
-        token.value_int = strtoll(num, &numerr, 0);
+        token->type = AKO_TT_INT;
+        ok = number_parse_int(num, num_size, &token->value_int);
     }
+    advance(lexer, num_size);
 
-    if (errno != 0 || strlen(numerr) > 0)
+    if (!ok)
     {
         // Failed
-        *err = ako_elem_create_errorf("Failed to parse number at %zu:%zu", state->meta.line, state->meta.column);
-        dyn_array_destroy(&state->tokens);
+        location_t loc = line_index_find(lexer->lines, lexer->meta);
+        lexer->err = ako_elem_create_errorf("Failed to parse number at %zu:%zu", loc.line, loc.column);
         return false;
     }
 
-    add_token(state, token);
+    // vectors can start now
+    lexer->after_number = true;
+    finish_token(lexer, token);
     return true;
 }
 
-dyn_array_t ako_tokenize(const char* source, ako_elem_t** err, bool ignore_floats)
+// Everything that can start a token, picked by the class of its first character
+
+static bool lex_none(lexer_t* lexer, token_t* token)
 {
-    static dyn_array_t empty_array = {0};
-    *err = NULL;
+    (void)token;
+    location_t loc = line_index_find(lexer->lines, lexer->meta);
+    lexer->err =
+        ako_elem_create_errorf("Unknown character %c at %zu:%zu", peek(lexer, 0), loc.line, loc.column);
+    return false;
+}
 
-    state_t* state = alloca(sizeof(state_t));
-    memset(state, 0, sizeof(state_t));
-    state->tokens = dyn_array_create(sizeof(token_t));
-    state->source = source;
-    state->source_len = strlen(source);
-    state->ignore_floats = ignore_floats;
-    state->current_loc.line = 1;
-    state->current_loc.column = 1;
-    token_t token;
-    memset(&token, 0, sizeof(token_t));
+static const uint8_t punct_tokens[128] = {
+    ['+'] = AKO_TT_PLUS, ['-'] = AKO_TT_MINUS,      [';'] = AKO_TT_SEMICOLON,   ['.'] = AKO_TT_DOT,
+    ['&'] = AKO_TT_AND,  ['['] = AKO_TT_OPEN_BRACE, [']'] = AKO_TT_CLOSE_BRACE,
+};
 
-    while (has_value(state, 0))
+static bool lex_punct(lexer_t* lexer, token_t* token)
+{
+    char c = consume(lexer);
+    token->type = (token_type_t)punct_tokens[(unsigned char)c];
+    token->value_int = token->type == AKO_TT_PLUS;
+
+    if (c == '[' || c == ']')
     {
-        char c = peek(state, 0);
-        if (c == ' ' || c == '\n' || c == '\t')
+        // Could be the first half of [[ or ]]
+        if (window_ended(lexer, 0))
         {
-            consume(state);
-            continue;
+            return starve(lexer);
+        }
+        if (has_value(lexer, 0) && peek(lexer, 0) == c)
+        {
+            token->type = c == '[' ? AKO_TT_OPEN_D_BRACE : AKO_TT_CLOSE_D_BRACE;
+            consume(lexer);
         }
+    }
 
-        if (c == '#')
+    finish_token(lexer, token);
+    return true;
+}
+
+static bool lex_ident(lexer_t* lexer, token_t* token)
+{
+    size_t id_size = count_id(lexer);
+    if (window_ended(lexer, id_size))
+    {
+        return starve(lexer);
+    }
+    token->type = AKO_TT_IDENT;
+    token->value_string.offset = lexer->index;
+    token->value_string.length = id_size;
+    token->value_string.escaped = false;
+    advance(lexer, id_size);
+    finish_token(lexer, token);
+    return true;
+}
+
+static bool lex_digit(lexer_t* lexer, token_t* token)
+{
+    return parse_digit(lexer, token);
+}
+
+static bool lex_quote(lexer_t* lexer, token_t* token)
+{
+    consume(lexer);
+    const char* source = lexer->source;
+    size_t str_start = lexer->index;
+    size_t iter = str_start;
+    bool escaped = false;
+
+    // Jump between quotes and escapes, the escapes get decoded once the parser copies the string out.
+    while (iter < lexer->source_len)
+    {
+        iter += lexer->scan->find_string_special(source + iter, lexer->source_len - iter);
+        if (iter >= lexer->source_len || source[iter] == '"')
         {
-            // Comment, skip until new line
-            consume(state);
-            size_t comment_line = state->current_loc.line;
-            while (state->current_loc.line == comment_line)
-            {
-                if (consume(state) == '\0')
-                {
-                    // No more text
-                    break;
-                }
-            }
-            continue;
+            break;
         }
 
-        start_meta(state);
+        escaped = true;
+        iter += 2;
+    }
+
+    if (window_ended(lexer, iter - lexer->index))
+    {
+        // No closing quote yet
+        return starve(lexer);
+    }
+
+    size_t str_end = iter < lexer->source_len ? iter : lexer->source_len;
+    token->type = AKO_TT_STRING;
+    token->value_string.offset = str_start;
+    token->value_string.length = str_end - str_start;
+    token->value_string.escaped = escaped;
+
+    // Move past the body and the closing quote, if there is one
+    advance(lexer, str_end - str_start);
+    consume(lexer);
+    finish_token(lexer, token);
+    return true;
+}
+
+// Whitespace and comments don't make tokens, lexer_next skips them itself
+static bool (*const lex_funcs[CHAR_CLASS_MAX])(lexer_t* lexer, token_t* token) = {
+    [CHAR_NONE] = lex_none,   [CHAR_PUNCT] = lex_punct, [CHAR_IDENT] = lex_ident,
+    [CHAR_DIGIT] = lex_digit, [CHAR_QUOTE] = lex_quote,
+};
+
+void lexer_init(lexer_t* lexer, const char* source, size_t source_len, bool ignore_floats, line_index_t* lines)
+{
+    assert(lines != NULL);
+    memset(lexer, 0, sizeof(lexer_t));
+    lexer->source = source;
+    lexer->source_len = source_len;
+    lexer->ignore_floats = ignore_floats;
+    lexer->scan = scan_get();
+    lexer->lines = lines;
+}
 
-        switch (c)
+void lexer_set_window(lexer_t* lexer, const char* source, size_t source_len, size_t base, bool more_coming)
+{
+    assert(base == lexer->base + lexer->index);
+    lexer->source = source;
+    lexer->source_len = source_len;
+    lexer->index = 0;
+    lexer->base = base;
+    lexer->more_coming = more_coming;
+}
+
+bool lexer_next(lexer_t* lexer, token_t* token)
+{
+    if (lexer->err != NULL)
+    {
+        return false;
+    }
+
+    memset(token, 0, sizeof(token_t));
+    lexer->starved = false;
+
+    if (lexer->in_comment)
+    {
+        size_t comment_len =
+            lexer->scan->find_line_end(lexer->source + lexer->index, lexer->source_len - lexer->index);
+        lexer->in_comment = window_ended(lexer, comment_len);
+        advance(lexer, comment_len);
+    }
+
+    // An x straight after a number continues a vector, and then has to be followed by another number
+    if (lexer->after_number)
+    {
+        if (window_ended(lexer, 0))
         {
-        case '+':
-            consume(state);
-            token.type = AKO_TT_PLUS;
-            token.value_int = 1;
-            add_token(state, token);
-            continue;
-        case '-':
-            consume(state);
-            token.type = AKO_TT_MINUS;
-            token.value_int = 0;
-            add_token(state, token);
-            continue;
-        case ';':
-            consume(state);
-            token.type = AKO_TT_SEMICOLON;
-            token.value_int = 0;
-            add_token(state, token);
-            continue;
-        case '.':
-            consume(state);
-            token.type = AKO_TT_DOT;
-            token.value_int = 0;
-            add_token(state, token);
-            continue;
-        case '&':
-            consume(state);
-            token.type = AKO_TT_AND;
-            token.value_int = 0;
-            add_token(state, token);
-            continue;
-        case '[':
-            consume(state);
-            token.value_int = 0;
-            if (has_value(state, 0) && peek(state, 0) == '[')
-            {
-                token.type = AKO_TT_OPEN_D_BRACE;
-                consume(state);
-            }
-            else
-            {
-                token.type = AKO_TT_OPEN_BRACE;
-            }
-            add_token(state, token);
-            continue;
-        case ']':
-            consume(state);
-            token.value_int = 0;
-            if (has_value(state, 0) && peek(state, 0) == ']')
+            lexer->starved = true;
+            return false;
+        }
+
+        lexer->after_number = false;
+        if (has_value(lexer, 0) && peek(lexer, 0) == 'x')
+        {
+            start_meta(lexer);
+            consume(lexer);
+            token->type = AKO_TT_VECTORCROSS;
+            finish_token(lexer, token);
+            lexer->in_vector = true;
+            return true;
+        }
+    }
+
+    if (lexer->in_vector)
+    {
+        lexer->in_vector = false;
+        size_t vector_delimiter = lexer->meta;
+        start_meta(lexer);
+        if (!parse_digit(lexer, token))
+        {
+            if (lexer->starved)
             {
-                token.type = AKO_TT_CLOSE_D_BRACE;
-                consume(state);
+                // Try again with more source, the error needs to point at the x still
+                lexer->in_vector = true;
+                lexer->meta = vector_delimiter;
+                return false;
             }
-            else
+
+            if (lexer->err == NULL)
             {
-                token.type = AKO_TT_CLOSE_BRACE;
+                // Failed to parse number and we had an X before, this isn't valid
+                location_t loc = line_index_find(lexer->lines, vector_delimiter);
+                lexer->err = ako_elem_create_errorf("Failed to parse vector at %zu:%zu", loc.line, loc.column);
             }
-            add_token(state, token);
+            return false;
+        }
+        return true;
+    }
+
+    while (has_value(lexer, 0))
+    {
+        char_class_t kind = get_class(peek(lexer, 0));
+        if (kind == CHAR_SPACE)
+        {
+            advance(lexer, lexer->scan->skip_whitespace(lexer->source + lexer->index,
+                                                        lexer->source_len - lexer->index));
             continue;
         }
 
-        if (is_valid_id(c))
+        if (kind == CHAR_HASH)
         {
-            size_t id_size = count_id(state);
-            size_t id_bytesize = sizeof(char) * id_size + 1;
-            char* id = ako_malloc(id_bytesize);
-            memset(id, '\0', id_bytesize);
-            for (size_t i = 0; i < id_size; ++i)
-            {
-                id[i] = consume(state);
-            }
-            token.type = AKO_TT_IDENT;
-            token.value_string = id;
-            add_token(state, token);
+            // Comment, skip until new line, the new line itself is left as whitespace
+            size_t comment_len =
+                lexer->scan->find_line_end(lexer->source + lexer->index, lexer->source_len - lexer->index);
+            lexer->in_comment = window_ended(lexer, comment_len);
+            advance(lexer, comment_len);
             continue;
         }
 
-        if (parse_digit(state, err))
+        start_meta(lexer);
+        return lex_funcs[kind](lexer, token);
+    }
+
+    // Out of source, if this is only a window then theres more to come
+    lexer->starved = lexer->more_coming;
+    return false;
+}
+
+static unsigned ctz64(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)mask))
+    {
+        return index;
+    }
+    _BitScanForward(&index, (unsigned long)(mask >> 32));
+    return index + 32;
+#else
+    return (unsigned)__builtin_ctzll(mask);
+#endif
+}
+
+static unsigned popcount64(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    // __popcnt64 needs a CPU with POPCNT, this doesn't
+    mask -= (mask >> 1) & 0x5555555555555555ull;
+    mask = (mask & 0x3333333333333333ull) + ((mask >> 2) & 0x3333333333333333ull);
+    mask = (mask + (mask >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (unsigned)((mask * 0x0101010101010101ull) >> 56);
+#else
+    return (unsigned)__builtin_popcountll(mask);
+#endif
+}
+
+// Every bit from bit up, bit has to be below 64
+static uint64_t bits_from(unsigned bit)
+{
+    return ~(uint64_t)0 << bit;
+}
+
+// Each bit ends up as the xor of itself and every bit below it, so it's set between an opening quote and
+// the closing one
+static uint64_t prefix_xor(uint64_t mask)
+{
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+}
+
+// Marks the bytes of a block that belong to a string or comment, the block has to start outside of both.
+// Returns where one that runs off the end of the block starts, or 64 if nothing does.
+static unsigned block_inside(const scan_block_t* block, uint64_t* inside)
+{
+    *inside = 0;
+    unsigned from = 0;
+    while (from < 64)
+    {
+        uint64_t starts = (block->quote | block->hash) & bits_from(from);
+        if (starts == 0)
+        {
+            break;
+        }
+
+        unsigned start = ctz64(starts);
+        uint64_t ends = 0;
+        if (block->hash & ((uint64_t)1 << start))
         {
-            // we parse a number
-            // vectors can start now
-            if (has_value(state, 0) && peek(state, 0) == 'x')
+            ends = start < 63 ? block->newline & bits_from(start + 1) : 0;
+        }
+        else
+        {
+            // Escapes are rare enough that stepping over them one at a time is fine
+            unsigned i = start + 1;
+            while (i < 64)
             {
-                while (has_value(state, 0) && peek(state, 0) == 'x')
+                uint64_t special = (block->quote | block->backslash) & bits_from(i);
+                if (special == 0)
                 {
-                    location_t vector_delimiter = state->current_loc;
-                    consume(state);
-                    token.type = AKO_TT_VECTORCROSS;
-                    token.value_int = 0;
-                    add_token(state, token);
-
-                    if (!parse_digit(state, err))
-                    {
-                        // Failed to parse number and we had an X before, this isn't valid
-                        *err = ako_elem_create_errorf("Failed to parse vector at %zu:%zu", vector_delimiter.line,
-                                                      vector_delimiter.column);
-                        dyn_array_destroy(&state->tokens);
-                        return empty_array;
-                    }
+                    break;
                 }
-                // Loop done
-                continue;
-            }
-            else
-            {
-                // normal digit
-                continue;
+                unsigned bit = ctz64(special);
+                if (block->quote & ((uint64_t)1 << bit))
+                {
+                    ends = (uint64_t)1 << bit;
+                    break;
+                }
+                i = bit + 2;
             }
         }
-        else if (*err != NULL && ako_elem_is_error(*err))
+
+        if (ends == 0)
         {
-            // if theres an error set then we failed to parse in a bad way
-            dyn_array_destroy(&state->tokens);
-            return empty_array;
+            *inside |= bits_from(start);
+            return start;
         }
 
-        if (c == '"')
+        unsigned end = ctz64(ends);
+        *inside |= bits_from(start) & ~bits_from(end);
+        from = end + 1;
+    }
+    return 64;
+}
+
+// Leaves iter after the quote that ends the string iter is in, or at len if there isn't one
+static size_t skip_string_rest(lexer_t* lexer, size_t iter)
+{
+    const char* source = lexer->source;
+    size_t len = lexer->source_len;
+    while (iter < len)
+    {
+        iter += lexer->scan->find_string_special(source + iter, len - iter);
+        if (iter >= len || source[iter++] == '"')
+        {
+            break;
+        }
+        if (iter < len)
         {
-            consume(state);
-            size_t char_count = count_string(state);
-            size_t str_bytesize = sizeof(char) * char_count + 1;
-            char* str = ako_malloc(str_bytesize);
-            memset(str, '\0', str_bytesize);
+            // Whatever the backslash escaped
+            iter++;
+        }
+    }
+    return iter;
+}
 
-            char* iter = str;
-            while (has_value(state, 0))
+bool lexer_skip_brackets(lexer_t* lexer, size_t depth)
+{
+    assert(!lexer->more_coming);
+    const char* source = lexer->source;
+    size_t len = lexer->source_len;
+    size_t iter = lexer->index;
+
+    // Only brackets, strings and comments matter, a bracket inside a string or comment doesn't count.
+    // Goes 64 bytes at a time off the classified masks, each block starts outside of strings and comments
+    // and one that runs past the end of the block gets finished off with the scanners.
+    while (depth > 0 && iter < len)
+    {
+        // Long runs with nothing interesting in them go faster through the scanners, so do strings and comments
+        // that start right here since they tend to be longer than a block
+        iter += lexer->scan->find_skip_special(source + iter, len - iter);
+        if (iter >= len)
+        {
+            break;
+        }
+        if (source[iter] == '#')
+        {
+            iter++;
+            iter += lexer->scan->find_line_end(source + iter, len - iter);
+            continue;
+        }
+        if (source[iter] == '"')
+        {
+            iter = skip_string_rest(lexer, iter + 1);
+            continue;
+        }
+
+        const char* data = source + iter;
+        char tail[64];
+        if (len - iter < 64)
+        {
+            // Spaces don't mean anything here
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, data, len - iter);
+            data = tail;
+        }
+
+        scan_block_t block;
+        lexer->scan->classify_block(data, &block);
+
+        uint64_t inside;
+        unsigned cut;
+        bool string_carries = false;
+        if ((block.hash | block.backslash) == 0)
+        {
+            // Only quotes, the usual case, every other one opens a string
+            inside = prefix_xor(block.quote);
+            cut = 64;
+            string_carries = (inside >> 63) != 0;
+        }
+        else
+        {
+            cut = block_inside(&block, &inside);
+        }
+
+        uint64_t opens = block.open & ~inside;
+        uint64_t closes = block.close & ~inside;
+        unsigned close_count = popcount64(closes);
+        if (close_count < depth)
+        {
+            // Can't get back to the top in this block, no need to look at the order
+            depth = depth + popcount64(opens) - close_count;
+        }
+        else
+        {
+            uint64_t brackets = opens | closes;
+            while (brackets != 0)
             {
-                char cc = consume(state);
-                if (cc == '\\')
+                unsigned bit = ctz64(brackets);
+                if ((opens >> bit) & 1)
                 {
-                    cc = consume(state);
-                    switch (cc)
-                    {
-                    case 'n':
-                        *iter = '\n';
-                        break;
-                    case 't':
-                        *iter = '\t';
-                        break;
-                    default:
-                        *iter = cc;
-                        break;
-                    }
-                    iter++;
-                    continue;
+                    depth++;
                 }
-                if (cc == '"')
+                else if (--depth == 0)
                 {
+                    iter += bit + 1;
                     break;
                 }
-                *iter = cc;
-                iter++;
+                brackets &= brackets - 1;
+            }
+            if (depth == 0)
+            {
+                break;
             }
-
-            token.type = AKO_TT_STRING;
-            token.value_string = str;
-            add_token(state, token);
-            continue;
         }
 
-        // If were here then we have a bad character
-        *err = ako_elem_create_errorf("Unknown character %c at %zu:%zu", c, state->meta.line, state->meta.column);
-        dyn_array_destroy(&state->tokens);
-        return empty_array;
+        if (string_carries)
+        {
+            iter = skip_string_rest(lexer, iter + 64);
+        }
+        else if (cut < 64 && data[cut] == '#')
+        {
+            iter += cut + 1;
+            iter += lexer->scan->find_line_end(source + iter, len - iter);
+        }
+        else if (cut < 64)
+        {
+            iter = skip_string_rest(lexer, iter + cut + 1);
+        }
+        else
+        {
+            iter += 64;
+        }
     }
 
-    return state->tokens;
+    lexer->index = iter < len ? iter : len;
+    lexer->after_number = false;
+    lexer->in_vector = false;
+    return depth == 0;
 }
 
-void ako_free_tokens(dyn_array_t* tokens)
+bool lexer_skip_next_brackets(lexer_t* lexer)
 {
-    for (size_t i = 0; i < tokens->size; ++i)
+    assert(!lexer->more_coming);
+    const char* source = lexer->source;
+    size_t len = lexer->source_len;
+    size_t iter = lexer->index;
+
+    while (iter < len)
     {
-        token_t* token = dyn_array_get(tokens, i);
-        if (token->type == AKO_TT_STRING || token->type == AKO_TT_IDENT)
+        iter += lexer->scan->find_skip_special(source + iter, len - iter);
+        if (iter >= len)
+        {
+            break;
+        }
+
+        char c = source[iter++];
+        if (c == '[')
         {
-            ako_free((void*)token->value_string);
+            lexer->index = iter;
+            return lexer_skip_brackets(lexer, 1);
+        }
+        if (c == ']')
+        {
+            lexer->index = iter - 1;
+            return false;
+        }
+        if (c == '#')
+        {
+            iter += lexer->scan->find_line_end(source + iter, len - iter);
+        }
+        else
+        {
+            iter = skip_string_rest(lexer, iter);
         }
     }
 
-    dyn_array_destroy(tokens);
-}
\ No newline at end of file
+    lexer->index = len;
+    return false;
+}
+
+token_list_t ako_tokenize(const char* source, size_t source_len, ako_elem_t** err, bool ignore_floats)
+{
+    static token_list_t empty_list = {0};
+    *err = NULL;
+
+    line_index_t lines;
+    line_index_init(&lines, source, source_len);
+    lexer_t lexer;
+    lexer_init(&lexer, source, source_len, ignore_floats, &lines);
+
+    token_list_t list;
+    token_buf_init(&list.tokens, source_len > TOKEN_PACKED_MAX_SOURCE);
+    list.source = source;
+
+    token_t token;
+    while (lexer_next(&lexer, &token))
+    {
+        token_buf_push(&list.tokens, &token);
+    }
+
+    line_index_destroy(&lines);
+    if (lexer.err != NULL)
+    {
+        *err = lexer.err;
+        token_buf_destroy(&list.tokens);
+        return empty_list;
+    }
+
+    return list;
+}
+
+void ako_free_tokens(token_list_t* list)
+{
+    token_buf_destroy(&list->tokens);
+    memset(list, 0, sizeof(token_list_t));
+}
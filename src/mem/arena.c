@@ -0,0 +1,127 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include "arena.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ako/ako.h"
+
+#define ARENA_ALIGN 8
+#define ARENA_MIN_CHUNK 4096
+// Past this chunks stop doubling, big documents end up with a few dozen chunks instead of huge ones
+#define ARENA_MAX_CHUNK (4 * 1024 * 1024)
+
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_chunk
+{
+    arena_chunk_t* next;
+    size_t used;
+    size_t capacity;
+    uint64_t data[]; // uint64_t keeps it aligned
+};
+
+void arena_init(arena_t* arena)
+{
+    arena->chunks = NULL;
+    arena->next_size = ARENA_MIN_CHUNK;
+}
+
+void arena_destroy(arena_t* arena)
+{
+    arena_chunk_t* chunk = arena->chunks;
+    while (chunk != NULL)
+    {
+        arena_chunk_t* next = chunk->next;
+        ako_free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
+
+static arena_chunk_t* _new_chunk(arena_t* arena, size_t size)
+{
+    size_t capacity = arena->next_size;
+    if (size > capacity)
+    {
+        // Too big for the usual chunk, give it one to itself
+        capacity = size;
+    }
+    else if (arena->next_size < ARENA_MAX_CHUNK)
+    {
+        arena->next_size *= 2;
+    }
+
+    arena_chunk_t* chunk = ako_malloc(sizeof(arena_chunk_t) + capacity);
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return chunk;
+}
+
+void arena_reset(arena_t* arena)
+{
+    arena_chunk_t* chunk = arena->chunks;
+    if (chunk == NULL)
+    {
+        return;
+    }
+    if (chunk->next == NULL)
+    {
+        chunk->used = 0;
+        return;
+    }
+
+    // Swap them all for one chunk that holds as much, so filling it the same way again doesn't allocate
+    size_t total = 0;
+    while (chunk != NULL)
+    {
+        arena_chunk_t* next = chunk->next;
+        total += chunk->capacity;
+        ako_free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    _new_chunk(arena, total);
+}
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    size = ARENA_ROUND(size);
+    arena_chunk_t* chunk = arena->chunks;
+    if (chunk == NULL || chunk->capacity - chunk->used < size)
+    {
+        chunk = _new_chunk(arena, size);
+    }
+
+    void* ptr = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void* arena_grow(arena_t* arena, void* ptr, size_t old_size, size_t new_size)
+{
+    if (ptr == NULL)
+    {
+        return arena_alloc(arena, new_size);
+    }
+    assert(new_size >= old_size);
+
+    old_size = ARENA_ROUND(old_size);
+    new_size = ARENA_ROUND(new_size);
+    arena_chunk_t* chunk = arena->chunks;
+    bool is_last = (char*)ptr + old_size == (char*)chunk->data + chunk->used;
+    if (is_last && chunk->capacity - chunk->used >= new_size - old_size)
+    {
+        chunk->used += new_size - old_size;
+        return ptr;
+    }
+
+    void* grown = arena_alloc(arena, new_size);
+    memcpy(grown, ptr, old_size);
+    return grown;
+}
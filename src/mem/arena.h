@@ -0,0 +1,23 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <stddef.h>
+
+// Bump allocator, nothing is freed on its own, everything goes at once in arena_destroy.
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct
+{
+    arena_chunk_t* chunks; // Newest first, allocations come out of the front one
+    size_t next_size;      // Size of the next chunk, doubles every time up to a limit
+} arena_t;
+
+void arena_init(arena_t* arena);
+void arena_destroy(arena_t* arena);
+// Frees everything that was allocated but keeps the memory around as one chunk for whatever comes next
+void arena_reset(arena_t* arena);
+// Always 8 byte aligned
+void* arena_alloc(arena_t* arena, size_t size);
+// Like realloc, grows in place if ptr was the last thing allocated and there's room.
+// Otherwise the old memory is left where it is until the arena goes.
+void* arena_grow(arena_t* arena, void* ptr, size_t old_size, size_t new_size);
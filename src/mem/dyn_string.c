@@ -25,6 +25,11 @@ void dyn_string_realloc(dyn_string_t* str, size_t new_capacity)
 
     if (str->capacity < new_capacity)
     {
+        // Grow geometrically so lots of small appends don't realloc every time
+        if (new_capacity < str->capacity * 2)
+        {
+            new_capacity = str->capacity * 2;
+        }
         char* new_data = ako_realloc(str->data, new_capacity);
         assert(new_data != NULL);
         str->data = new_data;
@@ -38,12 +43,21 @@ dyn_string_t dyn_string_create(size_t initial_capacity)
     memset(&str, 0, sizeof(dyn_string_t));
     dyn_string_realloc(&str, initial_capacity);
     str.size = 0;
+    if (str.data != NULL)
+    {
+        // Nothing might ever get appended, it should still read as an empty string
+        str.data[0] = '\0';
+    }
     return str;
 }
 
 void dyn_string_append(dyn_string_t* str, const char* data)
 {
-    size_t len = strlen(data);
+    dyn_string_append_n(str, data, strlen(data));
+}
+
+void dyn_string_append_n(dyn_string_t* str, const char* data, size_t len)
+{
     dyn_string_realloc(str, str->size + len + 1);
     memcpy(str->data + str->size, data, len);
     str->size += len;
@@ -77,6 +91,14 @@ void dyn_string_append_char(dyn_string_t* str, char c)
     str->data[str->size] = '\0';
 }
 
+void dyn_string_reserve(dyn_string_t* str, size_t capacity)
+{
+    if (str->capacity < capacity)
+    {
+        dyn_string_realloc(str, capacity);
+    }
+}
+
 void dyn_string_clear(dyn_string_t* str)
 {
     // Sets the entire data buffer to '\0' but keeps the allocated memory
@@ -14,8 +14,12 @@ typedef struct
 dyn_string_t dyn_string_create(size_t initial_capacity);
 
 void dyn_string_append(dyn_string_t* str, const char* data);
+void dyn_string_append_n(dyn_string_t* str, const char* data, size_t len);
 void dyn_string_append_fmt(dyn_string_t* str, const char* fmt, ...);
 void dyn_string_append_char(dyn_string_t* str, char c);
 
+// Makes sure there is room for at least capacity bytes, never shrinks
+void dyn_string_reserve(dyn_string_t* str, size_t capacity);
+
 // Sets the entire data buffer to '\0' but keeps the allocated memory
 void dyn_string_clear(dyn_string_t* str);
\ No newline at end of file
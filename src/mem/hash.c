@@ -0,0 +1,88 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include "hash.h"
+
+#include <time.h>
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        v0 += v1;                                                                                                      \
+        v1 = ROTL(v1, 13);                                                                                             \
+        v1 ^= v0;                                                                                                      \
+        v0 = ROTL(v0, 32);                                                                                             \
+        v2 += v3;                                                                                                      \
+        v3 = ROTL(v3, 16);                                                                                             \
+        v3 ^= v2;                                                                                                      \
+        v0 += v3;                                                                                                      \
+        v3 = ROTL(v3, 21);                                                                                             \
+        v3 ^= v0;                                                                                                      \
+        v2 += v1;                                                                                                      \
+        v1 = ROTL(v1, 17);                                                                                             \
+        v1 ^= v2;                                                                                                      \
+        v2 = ROTL(v2, 32);                                                                                             \
+    } while (0)
+
+static uint64_t splitmix(uint64_t x)
+{
+    x += UINT64_C(0x9E3779B97F4A7C15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+hash_seed_t hash_seed_random(const void* salt)
+{
+    // Nothing here is secret on its own but with ASLR the addresses are different every run
+    uint64_t local = 0;
+    uint64_t state = (uint64_t)(uintptr_t)salt ^ ((uint64_t)(uintptr_t)&local << 17) ^ (uint64_t)time(NULL) ^
+                     ((uint64_t)clock() << 32);
+
+    hash_seed_t seed;
+    seed.k0 = splitmix(state);
+    seed.k1 = splitmix(seed.k0 ^ (uint64_t)(uintptr_t)&hash_seed_random);
+    return seed;
+}
+
+static uint64_t read_u64(const uint8_t* p)
+{
+    // Byte by byte so it's little endian everywhere and doesn't care about alignment
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+uint64_t hash_bytes(const hash_seed_t* seed, const void* data, size_t len)
+{
+    const uint8_t* in = data;
+    uint64_t v0 = UINT64_C(0x736f6d6570736575) ^ seed->k0;
+    uint64_t v1 = UINT64_C(0x646f72616e646f6d) ^ seed->k1;
+    uint64_t v2 = UINT64_C(0x6c7967656e657261) ^ seed->k0;
+    uint64_t v3 = UINT64_C(0x7465646279746573) ^ seed->k1;
+
+    const uint8_t* end = in + (len & ~(size_t)7);
+    for (; in != end; in += 8)
+    {
+        uint64_t m = read_u64(in);
+        v3 ^= m;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    uint64_t b = (uint64_t)len << 56;
+    for (size_t i = 0; i < (len & 7); ++i)
+    {
+        b |= (uint64_t)in[i] << (8 * i);
+    }
+
+    v3 ^= b;
+    SIPROUND;
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,17 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t k0;
+    uint64_t k1;
+} hash_seed_t;
+
+// Mixes salt with addresses and the clock so keys can't be picked ahead of time to collide.
+// Pass something unique to the caller as salt, like the address of what the seed is for.
+hash_seed_t hash_seed_random(const void* salt);
+// SipHash-1-3, keyed so the output can't be predicted without the seed.
+uint64_t hash_bytes(const hash_seed_t* seed, const void* data, size_t len);
@@ -0,0 +1,201 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include "intern.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "ako/ako.h"
+#include "hash.h"
+
+// Strings are packed into blocks instead of getting an allocation each
+#define INTERN_BLOCK_SIZE 4096
+#define INTERN_MIN_SLOTS 64
+
+typedef struct intern_block
+{
+    struct intern_block* next;
+    size_t used;
+    size_t capacity;
+    // Keys go here, kept aligned for struct ako_key
+    uint64_t data[];
+} intern_block_t;
+
+typedef struct
+{
+    uint64_t hash; // Copy of key->hash so probing and growing don't have to touch the keys
+    const struct ako_key* key;
+} intern_slot_t;
+
+struct intern_pool
+{
+    size_t refs;
+    hash_seed_t seed;
+    size_t mask; // Slot count - 1, always a power of two
+    size_t used;
+    intern_slot_t* slots;
+    intern_block_t* blocks; // Newest first
+};
+
+intern_pool_t* intern_pool_create(void)
+{
+    intern_pool_t* pool = ako_malloc(sizeof(intern_pool_t));
+    memset(pool, 0, sizeof(intern_pool_t));
+    pool->refs = 1;
+    pool->seed = hash_seed_random(pool);
+    pool->mask = INTERN_MIN_SLOTS - 1;
+    pool->slots = ako_malloc(INTERN_MIN_SLOTS * sizeof(intern_slot_t));
+    memset(pool->slots, 0, INTERN_MIN_SLOTS * sizeof(intern_slot_t));
+    return pool;
+}
+
+void intern_pool_retain(intern_pool_t* pool)
+{
+    assert(pool != NULL);
+    pool->refs++;
+}
+
+void intern_pool_release(intern_pool_t* pool)
+{
+    assert(pool != NULL);
+    assert(pool->refs > 0);
+    if (--pool->refs > 0)
+    {
+        return;
+    }
+
+    intern_block_t* block = pool->blocks;
+    while (block != NULL)
+    {
+        intern_block_t* next = block->next;
+        ako_free(block);
+        block = next;
+    }
+    ako_free(pool->slots);
+    ako_free(pool);
+}
+
+void intern_pool_clear(intern_pool_t* pool)
+{
+    assert(pool != NULL);
+    intern_block_t* keep = pool->blocks;
+    if (keep != NULL)
+    {
+        intern_block_t* block = keep->next;
+        while (block != NULL)
+        {
+            intern_block_t* next = block->next;
+            ako_free(block);
+            block = next;
+        }
+        keep->next = NULL;
+        keep->used = 0;
+    }
+
+    memset(pool->slots, 0, (pool->mask + 1) * sizeof(intern_slot_t));
+    pool->used = 0;
+}
+
+static size_t _find_slot(intern_pool_t* pool, uint64_t hash, const char* str, size_t len)
+{
+    size_t i = (size_t)hash & pool->mask;
+    while (pool->slots[i].key != NULL)
+    {
+        const struct ako_key* key = pool->slots[i].key;
+        if (pool->slots[i].hash == hash && key->length == len && memcmp(key->str, str, len) == 0)
+        {
+            break;
+        }
+        i = (i + 1) & pool->mask;
+    }
+    return i;
+}
+
+static void _grow(intern_pool_t* pool)
+{
+    size_t old_count = pool->mask + 1;
+    intern_slot_t* old_slots = pool->slots;
+
+    size_t count = old_count * 2;
+    pool->slots = ako_malloc(count * sizeof(intern_slot_t));
+    memset(pool->slots, 0, count * sizeof(intern_slot_t));
+    pool->mask = count - 1;
+
+    for (size_t i = 0; i < old_count; ++i)
+    {
+        if (old_slots[i].key == NULL)
+        {
+            continue;
+        }
+
+        size_t slot = (size_t)old_slots[i].hash & pool->mask;
+        while (pool->slots[slot].key != NULL)
+        {
+            slot = (slot + 1) & pool->mask;
+        }
+        pool->slots[slot] = old_slots[i];
+    }
+    ako_free(old_slots);
+}
+
+static struct ako_key* _alloc_key(intern_pool_t* pool, size_t len)
+{
+    // Round up so the next key stays aligned
+    size_t words = (offsetof(struct ako_key, str) + len + 1 + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    intern_block_t* block = pool->blocks;
+    if (block == NULL || block->capacity - block->used < words)
+    {
+        size_t capacity = INTERN_BLOCK_SIZE / sizeof(uint64_t);
+        if (words > capacity)
+        {
+            // Really long key, give it a block to itself
+            capacity = words;
+        }
+
+        block = ako_malloc(sizeof(intern_block_t) + capacity * sizeof(uint64_t));
+        block->used = 0;
+        block->capacity = capacity;
+        block->next = pool->blocks;
+        pool->blocks = block;
+    }
+
+    struct ako_key* key = (struct ako_key*)(block->data + block->used);
+    block->used += words;
+    return key;
+}
+
+const struct ako_key* intern_pool_add(intern_pool_t* pool, const char* str, size_t len)
+{
+    assert(pool != NULL);
+    uint64_t hash = hash_bytes(&pool->seed, str, len);
+    size_t slot = _find_slot(pool, hash, str, len);
+    if (pool->slots[slot].key != NULL)
+    {
+        return pool->slots[slot].key;
+    }
+
+    struct ako_key* key = _alloc_key(pool, len);
+    key->pool = pool;
+    key->hash = hash;
+    key->length = len;
+    memcpy(key->str, str, len);
+    key->str[len] = '\0';
+
+    pool->slots[slot].hash = hash;
+    pool->slots[slot].key = key;
+    pool->used++;
+    // Stay at most half full so probes stay short
+    if (pool->used * 2 > pool->mask + 1)
+    {
+        _grow(pool);
+    }
+    return key;
+}
+
+const struct ako_key* intern_pool_find(intern_pool_t* pool, const char* str, size_t len)
+{
+    assert(pool != NULL);
+    uint64_t hash = hash_bytes(&pool->seed, str, len);
+    return pool->slots[_find_slot(pool, hash, str, len)].key;
+}
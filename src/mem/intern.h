@@ -0,0 +1,34 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Stores each distinct string once so everything using it can share the same pointer.
+// Pools are reference counted, every table using one holds a reference.
+typedef struct intern_pool intern_pool_t;
+
+// What an ako_key_t points at
+struct ako_key
+{
+    intern_pool_t* pool;
+    uint64_t hash; // Seeded hash of str, good for hash tables outside the pool too
+    size_t length;
+    char str[]; // NUL terminated
+};
+
+// Gets the key back from its str, only valid for strings handed out by a pool
+#define INTERN_KEY_FROM_STR(s) ((const struct ako_key*)((s) - offsetof(struct ako_key, str)))
+
+// Starts with one reference
+intern_pool_t* intern_pool_create(void);
+void intern_pool_retain(intern_pool_t* pool);
+// Frees the pool and every string in it once the last reference is gone
+void intern_pool_release(intern_pool_t* pool);
+// Forgets every string but keeps the memory for the next ones. Only safe once nothing points at the old strings.
+void intern_pool_clear(intern_pool_t* pool);
+
+// Returns the existing copy if there is one
+const struct ako_key* intern_pool_add(intern_pool_t* pool, const char* str, size_t len);
+// Returns NULL if the string was never added
+const struct ako_key* intern_pool_find(intern_pool_t* pool, const char* str, size_t len);
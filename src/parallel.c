@@ -0,0 +1,250 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include <ako/ako.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lex/parser.h"
+#include "lex/token.h"
+#include "private.h"
+#include "thread.h"
+
+// Smallest piece worth giving its own thread
+#define PARALLEL_MIN_PART (64 * 1024)
+
+typedef struct
+{
+    const char* source;
+    size_t length;
+    ako_elem_t* result;
+    thread_t thread;
+    bool started; // Running on thread, otherwise it was parsed on the calling one
+} parallel_part_t;
+
+static void part_parse(void* ud)
+{
+    parallel_part_t* part = ud;
+    part->result = ako_parse_source_part(part->source, part->length);
+}
+
+// Splits can only go between statements at the top level, the only place that's known to be one without parsing
+// everything before it is right after a table or array. Gets at least min bytes past start if it can.
+static size_t find_split(lexer_t* lexer, size_t start, size_t min)
+{
+    lexer->index = start;
+    size_t split = start;
+    while (split - start < min)
+    {
+        if (!lexer_skip_next_brackets(lexer))
+        {
+            // Out of tables and arrays, or the root closes and the parser ignores the rest anyway
+            return lexer->source_len;
+        }
+        split = lexer->index;
+    }
+    return split;
+}
+
+ako_elem_t* ako_parse_parallel(const char* source, size_t length, size_t nthreads)
+{
+    if (nthreads == 0)
+    {
+        nthreads = thread_cpu_count();
+    }
+    if (source == NULL || nthreads == 1 || length < PARALLEL_MIN_PART * 2)
+    {
+        return ako_parse_n(source, length);
+    }
+
+    // No more threads than pieces the source can be split into, which also keeps the parts allocation below from
+    // overflowing
+    if (nthreads > length / PARALLEL_MIN_PART)
+    {
+        nthreads = length / PARALLEL_MIN_PART;
+    }
+    size_t part_size = length / nthreads;
+
+    line_index_t lines;
+    line_index_init(&lines, source, length);
+    lexer_t lexer;
+    lexer_init(&lexer, source, length, false, &lines);
+
+    // A root in brackets is a single value, there's nowhere to split it
+    token_t first;
+    if (!lexer_next(&lexer, &first) || first.type == AKO_TT_OPEN_BRACE || first.type == AKO_TT_OPEN_D_BRACE)
+    {
+        if (lexer.err != NULL)
+        {
+            ako_elem_destroy(lexer.err);
+        }
+        line_index_destroy(&lines);
+        return ako_parse_n(source, length);
+    }
+
+    // Each piece is handed to a thread as soon as its end is found, the last one is parsed here
+    parallel_part_t* parts = ako_malloc(nthreads * sizeof(parallel_part_t));
+    memset(parts, 0, nthreads * sizeof(parallel_part_t));
+    size_t count = 0;
+    size_t start = 0;
+    while (count + 1 < nthreads)
+    {
+        size_t split = find_split(&lexer, start, part_size);
+        if (split >= length)
+        {
+            break;
+        }
+
+        parallel_part_t* part = &parts[count++];
+        part->source = source + start;
+        part->length = split - start;
+        part->started = thread_start(&part->thread, part_parse, part);
+        if (!part->started)
+        {
+            part_parse(part);
+        }
+        start = split;
+    }
+    line_index_destroy(&lines);
+
+    parallel_part_t* last = &parts[count++];
+    last->source = source + start;
+    last->length = length - start;
+    part_parse(last);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (parts[i].started)
+        {
+            thread_join(&parts[i].thread);
+        }
+    }
+
+    // Put back together in source order. The first piece always has something in it, later ones might only
+    // be whitespace and comments.
+    ako_elem_t* root = parts[0].result;
+    bool merged = root != NULL && root->type == AT_TABLE;
+    for (size_t i = 1; i < count; ++i)
+    {
+        ako_elem_t* result = parts[i].result;
+        if (result == NULL)
+        {
+            continue;
+        }
+        if (merged && (result->type != AT_TABLE || !ako_elem_table_merge(root, result)))
+        {
+            merged = false;
+        }
+        ako_elem_destroy(result);
+    }
+    ako_free(parts);
+
+    if (!merged)
+    {
+        // Errors should be rare, parsing again in one go is the easy way to give back the same one
+        // ako_parse_n would have, with the right location
+        if (root != NULL)
+        {
+            ako_elem_destroy(root);
+        }
+        return ako_parse_n(source, length);
+    }
+
+    ako_elem_table_clear_dotted(root);
+    return root;
+}
+
+typedef struct
+{
+    size_t length;
+    size_t index;
+} batch_item_t;
+
+typedef struct
+{
+    const char** sources;
+    const batch_item_t* items; // Biggest first, so a huge one doesn't get started last and hold everyone up
+    size_t n;
+    ako_elem_t** out;
+    volatile size_t next; // Next item for whichever thread gets to it first
+} batch_t;
+
+static int batch_item_compare(const void* a, const void* b)
+{
+    const batch_item_t* left = a;
+    const batch_item_t* right = b;
+    if (left->length != right->length)
+    {
+        return left->length > right->length ? -1 : 1;
+    }
+    return left->index < right->index ? -1 : 1;
+}
+
+static void batch_work(void* ud)
+{
+    batch_t* batch = ud;
+    for (size_t i = thread_fetch_inc(&batch->next); i < batch->n; i = thread_fetch_inc(&batch->next))
+    {
+        const batch_item_t* item = &batch->items[i];
+        batch->out[item->index] = ako_parse_n(batch->sources[item->index], item->length);
+    }
+}
+
+void ako_parse_batch(const char** sources, const size_t* lengths, size_t n, ako_elem_t** out, unsigned threads)
+{
+    assert(n == 0 || (sources != NULL && out != NULL));
+    if (threads == 0)
+    {
+        threads = (unsigned)thread_cpu_count();
+    }
+    if (threads > n)
+    {
+        threads = (unsigned)n;
+    }
+
+    batch_item_t* items = ako_malloc((n > 0 ? n : 1) * sizeof(batch_item_t));
+    for (size_t i = 0; i < n; ++i)
+    {
+        items[i].index = i;
+        if (lengths != NULL)
+        {
+            items[i].length = lengths[i];
+        }
+        else
+        {
+            items[i].length = sources[i] != NULL ? strlen(sources[i]) : 0;
+        }
+    }
+    qsort(items, n, sizeof(batch_item_t), batch_item_compare);
+
+    batch_t batch;
+    batch.sources = sources;
+    batch.items = items;
+    batch.n = n;
+    batch.out = out;
+    batch.next = 0;
+
+    // Whoever is free takes the next source, this thread included. Parses don't share anything so there's
+    // nothing to lock besides the counter.
+    thread_t* workers = NULL;
+    unsigned started = 0;
+    if (threads > 1)
+    {
+        workers = ako_malloc((threads - 1) * sizeof(thread_t));
+        while (started < threads - 1 && thread_start(&workers[started], batch_work, &batch))
+        {
+            started++;
+        }
+    }
+    batch_work(&batch);
+
+    for (unsigned i = 0; i < started; ++i)
+    {
+        thread_join(&workers[i]);
+    }
+    if (workers != NULL)
+    {
+        ako_free(workers);
+    }
+    ako_free(items);
+}
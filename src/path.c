@@ -0,0 +1,351 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include <ako/ako.h>
+#include <assert.h>
+#include <string.h>
+
+#include "lex/token.h"
+#include "private.h"
+
+typedef struct
+{
+    const char* key; // NULL if this is an array index
+    size_t key_len;
+    size_t index;
+} path_segment_t;
+
+// Everything is in one allocation, the segments are followed by the keys they point at
+struct ako_path
+{
+    size_t count;
+    path_segment_t segments[];
+};
+
+static bool is_ident_char(char c)
+{
+    // Same as the tokenizer, letters, '_' and anything non ASCII
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (unsigned char)c >= 0x80;
+}
+
+static bool is_digit_char(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Most paths are nothing but identifiers and indices split by dots, those don't need the tokenizer.
+// Returns NULL if the path has anything else in it.
+static ako_path_t* path_compile_plain(const char* path, size_t len)
+{
+    size_t count = 1;
+    size_t segment_len = 0;
+    bool all_digits = true;
+    for (size_t i = 0; i <= len; ++i)
+    {
+        if (i == len || path[i] == '.')
+        {
+            // Indices that could overflow are left for the tokenizer to complain about
+            if (segment_len == 0 || (all_digits && segment_len > 18))
+            {
+                return NULL;
+            }
+            count += (i < len);
+            segment_len = 0;
+            all_digits = true;
+            continue;
+        }
+
+        bool is_digit = is_digit_char(path[i]);
+        if (!is_digit && (!is_ident_char(path[i]) || (all_digits && segment_len > 0)))
+        {
+            // Identifiers can't start with a digit
+            return NULL;
+        }
+        all_digits = all_digits && is_digit;
+        segment_len++;
+    }
+
+    size_t segments_size = sizeof(ako_path_t) + count * sizeof(path_segment_t);
+    ako_path_t* compiled = ako_malloc(segments_size + len + count);
+    compiled->count = count;
+    char* keys = (char*)compiled + segments_size;
+
+    const char* start = path;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const char* end = memchr(start, '.', (size_t)(path + len - start));
+        if (end == NULL)
+        {
+            end = path + len;
+        }
+
+        path_segment_t* segment = &compiled->segments[i];
+        segment->key_len = (size_t)(end - start);
+        if (is_digit_char(*start))
+        {
+            segment->key = NULL;
+            segment->index = 0;
+            for (const char* digit = start; digit < end; ++digit)
+            {
+                segment->index = segment->index * 10 + (size_t)(*digit - '0');
+            }
+            segment->key_len = 0;
+        }
+        else
+        {
+            memcpy(keys, start, segment->key_len);
+            keys[segment->key_len] = '\0';
+            segment->key = keys;
+            segment->index = 0;
+            keys += segment->key_len + 1;
+        }
+        start = end + 1;
+    }
+    return compiled;
+}
+
+// Paths are segments split by dots, a segment is an identifier, a string or an index
+ako_path_t* ako_path_compile(const char* path)
+{
+    assert(path != NULL);
+
+    size_t len = strlen(path);
+    ako_path_t* plain = path_compile_plain(path, len);
+    if (plain != NULL)
+    {
+        return plain;
+    }
+
+    ako_elem_t* err;
+    token_list_t list = ako_tokenize(path, len, &err, true);
+    if (err != NULL)
+    {
+        ako_elem_destroy(err);
+        return NULL;
+    }
+
+    // Check it all first, decoded keys are never longer than the token so that's enough room for them
+    size_t token_count = list.tokens.tokens.size;
+    size_t key_room = 0;
+    token_t token;
+    for (size_t i = 0; i < token_count; ++i)
+    {
+        token_buf_get(&list.tokens, i, &token);
+        bool is_segment = token.type == AKO_TT_IDENT || token.type == AKO_TT_STRING || token.type == AKO_TT_INT;
+        bool is_valid = (i % 2) == 1 ? token.type == AKO_TT_DOT : is_segment;
+        if (!is_valid || (token.type == AKO_TT_INT && token.value_int < 0))
+        {
+            ako_free_tokens(&list);
+            return NULL;
+        }
+        if (token.type == AKO_TT_IDENT || token.type == AKO_TT_STRING)
+        {
+            key_room += token.value_string.length + 1;
+        }
+    }
+    if (token_count == 0 || token_count % 2 == 0)
+    {
+        // Empty or ends on a dot
+        ako_free_tokens(&list);
+        return NULL;
+    }
+
+    size_t count = (token_count + 1) / 2;
+    size_t segments_size = sizeof(ako_path_t) + count * sizeof(path_segment_t);
+    ako_path_t* compiled = ako_malloc(segments_size + key_room);
+    compiled->count = count;
+    char* keys = (char*)compiled + segments_size;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        token_buf_get(&list.tokens, i * 2, &token);
+        path_segment_t* segment = &compiled->segments[i];
+        if (token.type == AKO_TT_INT)
+        {
+            segment->key = NULL;
+            segment->key_len = 0;
+            segment->index = (size_t)token.value_int;
+            continue;
+        }
+
+        segment->key_len = token_copy_string(list.source, &token, keys);
+        keys[segment->key_len] = '\0';
+        segment->key = keys;
+        segment->index = 0;
+        keys += segment->key_len + 1;
+    }
+
+    ako_free_tokens(&list);
+    return compiled;
+}
+
+void ako_path_destroy(ako_path_t* path)
+{
+    assert(path != NULL);
+    ako_free(path);
+}
+
+// One step down the tree, NULL if there's nothing there
+static ako_elem_t* path_step(ako_elem_t* elem, const path_segment_t* segment)
+{
+    if (segment->key == NULL)
+    {
+        if (elem->type != AT_ARRAY || segment->index >= ako_elem_array_get_length(elem))
+        {
+            return NULL;
+        }
+        return ako_elem_array_get(elem, segment->index);
+    }
+
+    if (elem->type != AT_TABLE)
+    {
+        return NULL;
+    }
+    return ako_elem_table_get_n(elem, segment->key, segment->key_len);
+}
+
+ako_elem_t* ako_elem_get_path(ako_elem_t* root, const ako_path_t* path)
+{
+    assert(root != NULL);
+    assert(path != NULL);
+
+    ako_elem_t* elem = root;
+    for (size_t i = 0; i < path->count && elem != NULL; ++i)
+    {
+        elem = path_step(elem, &path->segments[i]);
+    }
+    return elem;
+}
+
+size_t ako_elem_get_many(ako_elem_t* root, const char** paths, size_t n, ako_elem_t** out)
+{
+    assert(root != NULL);
+    assert(n == 0 || (paths != NULL && out != NULL));
+
+    size_t found = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        ako_path_t* path = ako_path_compile(paths[i]);
+        out[i] = path != NULL ? ako_elem_get_path(root, path) : NULL;
+        if (out[i] != NULL)
+        {
+            found++;
+        }
+        if (path != NULL)
+        {
+            ako_path_destroy(path);
+        }
+    }
+    return found;
+}
+
+static bool segment_equal(const path_segment_t* a, const path_segment_t* b)
+{
+    if (a->key == NULL || b->key == NULL)
+    {
+        return a->key == b->key && a->index == b->index;
+    }
+    return a->key_len == b->key_len && memcmp(a->key, b->key, a->key_len) == 0;
+}
+
+typedef struct
+{
+    const path_segment_t* segment; // NULL for the root
+    size_t first_child;            // 0 if there are none
+    size_t next_sibling;
+    bool ends;      // A path stops here
+    bool has_index; // A path carries on into an array
+} select_node_t;
+
+struct select_tree
+{
+    ako_path_t** paths; // Nodes point at their segments
+    size_t path_count;
+    dyn_array_t nodes;
+};
+
+select_tree_t* select_tree_create(const char** paths, size_t n)
+{
+    select_tree_t* tree = ako_malloc(sizeof(select_tree_t));
+    tree->paths = ako_malloc((n > 0 ? n : 1) * sizeof(ako_path_t*));
+    tree->path_count = 0;
+    tree->nodes = dyn_array_create(sizeof(select_node_t));
+    select_node_t root = {NULL, 0, 0, false, false};
+    DYN_APPEND(&tree->nodes, root);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        ako_path_t* path = ako_path_compile(paths[i]);
+        if (path == NULL)
+        {
+            select_tree_destroy(tree);
+            return NULL;
+        }
+        tree->paths[tree->path_count++] = path;
+
+        size_t node = 0;
+        for (size_t s = 0; s < path->count; ++s)
+        {
+            const path_segment_t* segment = &path->segments[s];
+            select_node_t* parent = dyn_array_get(&tree->nodes, node);
+            if (segment->key == NULL)
+            {
+                // The whole array gets kept so where it goes from here doesn't matter
+                parent->has_index = true;
+                break;
+            }
+
+            size_t child = parent->first_child;
+            while (child != 0 && !segment_equal(((select_node_t*)dyn_array_get(&tree->nodes, child))->segment, segment))
+            {
+                child = ((select_node_t*)dyn_array_get(&tree->nodes, child))->next_sibling;
+            }
+            if (child == 0)
+            {
+                select_node_t added = {segment, 0, parent->first_child, false, false};
+                child = tree->nodes.size;
+                DYN_APPEND(&tree->nodes, added);
+                // Appending might have moved the parent
+                ((select_node_t*)dyn_array_get(&tree->nodes, node))->first_child = child;
+            }
+
+            node = child;
+            if (s + 1 == path->count)
+            {
+                ((select_node_t*)dyn_array_get(&tree->nodes, node))->ends = true;
+            }
+        }
+    }
+
+    return tree;
+}
+
+void select_tree_destroy(select_tree_t* tree)
+{
+    assert(tree != NULL);
+    for (size_t i = 0; i < tree->path_count; ++i)
+    {
+        ako_path_destroy(tree->paths[i]);
+    }
+    dyn_array_destroy(&tree->nodes);
+    ako_free(tree->paths);
+    ako_free(tree);
+}
+
+size_t select_tree_key(const select_tree_t* tree, size_t node, const char* key, size_t key_len)
+{
+    const select_node_t* nodes = tree->nodes.internal.data;
+    for (size_t child = nodes[node].first_child; child != 0; child = nodes[child].next_sibling)
+    {
+        const path_segment_t* segment = nodes[child].segment;
+        if (segment->key_len == key_len && memcmp(segment->key, key, key_len) == 0)
+        {
+            return nodes[child].ends ? SELECT_ALL : child;
+        }
+    }
+    return SELECT_NONE;
+}
+
+bool select_tree_wants_array(const select_tree_t* tree, size_t node)
+{
+    return ((const select_node_t*)tree->nodes.internal.data)[node].has_index;
+}
@@ -1,36 +1,137 @@
 // Copyright (c) 2025 Tuyuji, Reece Hagan
 // SPDX-License-Identifier: MIT
 #pragma once
+#include <ako/ako.h>
 #include <ako/elem.h>
 #include <ako/types.h>
 
+#include "lex/token.h"
+#include "mem/arena.h"
 #include "mem/dyn_array.h"
+#include "mem/intern.h"
 
-typedef struct table_elem
-{
-    const char* key;
-    ako_elem_t* value;
-} table_elem_t;
-
-typedef struct array_elem
-{
-    ako_elem_t* item;
-} array_elem_t;
+// Flags for ako_elem_t
+#define ELEM_INLINE 1 // Lives in its parent's entries instead of its own allocation
+#define ELEM_REF 2    // Entry that only points at an element that was added from outside, see ref
+#define ELEM_PACKED_INT 4   // Array of nothing but ints, kept as a plain ako_int[] in packed
+#define ELEM_PACKED_FLOAT 8 // Same but ako_float[]
+#define ELEM_PACKED (ELEM_PACKED_INT | ELEM_PACKED_FLOAT)
+#define ELEM_VECTOR 16 // Array of up to 4 numbers kept right in the element, see vec
+#define ELEM_LAZY 32   // Table or array in a lazy document that hasn't been parsed yet, see lazy
+#define ELEM_DOTTED 64       // Table a dotted key made in a piece of a parallel parse, see ako_parse_source_part
+#define ELEM_DOTTED_INTO 128 // Table a dotted key went into after it was set in a piece of a parallel parse
 
-typedef union elem {
-    table_elem_t table;
-    array_elem_t array;
-} elem_t;
+// A number in a packed array or vector, which one it is gets tracked separately
+typedef union elem_number {
+    ako_int i;
+    ako_float f;
+} elem_number_t;
 
 typedef struct ako_elem
 {
     ako_type_t type;
+    uint8_t flags;
+    uint8_t vec_length; // ELEM_VECTOR, how many numbers are in vec
+    uint8_t vec_floats; // ELEM_VECTOR, bit n is set if vec[n] is a float
+    ako_doc_t* doc; // Set if the element lives in a document's arena instead of the heap
     union {
         const char* str; // String, ShortType
         ako_int i;       // Int, Bool(1 true, 0 false)
         ako_float f;
-        dyn_array_t a; // stores an array of elem_t
+        struct ako_elem* ref; // ELEM_REF entries, the element that was handed to ako_elem_table_add/array_add
+        elem_number_t vec[4]; // ELEM_VECTOR arrays
+        struct
+        {
+            size_t start; // Offset of the opening bracket in the document's source
+            size_t end;   // Just past the closing bracket
+            size_t depth; // How many tables and arrays it's inside of, for max_depth
+        } lazy;           // ELEM_LAZY tables and arrays, keys is left alone so tables still share the document's
+        struct
+        {
+            union {
+                void** blocks; // Entries live in here, see container_entry in elem.c
+                void* packed;  // ELEM_PACKED arrays keep their numbers here instead
+            };
+            size_t length; // How many entries there are
+            union {
+                struct
+                {
+                    struct table_index* index; // Tables only, hashed lookup built once they get big enough
+                    intern_pool_t* keys;       // Tables only, if set keys are interned here instead of owned
+                };
+                size_t capacity; // ELEM_PACKED arrays, how many numbers fit in packed
+            };
+        };
     };
 } ako_elem_t;
 
-extern char* empty;
\ No newline at end of file
+// A table keeps each key right next to its value, arrays just store the values
+typedef struct table_entry
+{
+    const char* key;
+    ako_elem_t value;
+} table_entry_t;
+
+struct ako_doc
+{
+    arena_t arena;
+    intern_pool_t* keys; // Every table in the document interns its keys here
+    ako_elem_t* root;
+    dyn_array_t adopted; // Heap elements that were added to the document, destroyed along with it
+
+    // Lazy documents only, see ako_doc_parse_lazy
+    const char* source; // NULL if the document isn't lazy
+    size_t source_len;
+    line_index_t lines;
+    ako_parse_opts_t opts;
+    ako_elem_t* error; // First error hit while loading a table or array
+    bool loaded_all;
+};
+
+extern char* empty;
+
+// Same as the public functions but the key/string doesn't need to be NUL terminated.
+// Used by the parser so it can copy straight out of the source.
+ako_elem_t* ako_elem_table_add_n(ako_elem_t* table, const char* key, size_t key_len, ako_elem_t* value);
+ako_elem_t* ako_elem_table_get_n(ako_elem_t* table, const char* key, size_t key_len);
+// Adds a new element of type straight into the table's or array's entries and returns it.
+// Unlike the public add functions there's no separate allocation for the child.
+ako_elem_t* ako_elem_table_emplace_n(ako_elem_t* table, const char* key, size_t key_len, ako_type_t type);
+ako_elem_t* ako_elem_array_emplace(ako_elem_t* array, ako_type_t type);
+// Adds a number to an array that's empty or already packed with the same kind, false if it's anything else.
+bool ako_elem_array_pack_int(ako_elem_t* array, ako_int value);
+bool ako_elem_array_pack_float(ako_elem_t* array, ako_float value);
+// Makes elem an ELEM_VECTOR array, bit n of floats says if numbers[n] is a float
+void ako_elem_set_vector(ako_elem_t* elem, const elem_number_t* numbers, size_t length, uint8_t floats);
+// Moves every entry of from onto the end of table, as if from's source came straight after table's.
+// Tables flagged ELEM_DOTTED go into the first table with the same key if there is one, same as a dotted key would.
+// False if that can't be worked out from the two tables, table and from are still safe to destroy but not use.
+bool ako_elem_table_merge(ako_elem_t* table, ako_elem_t* from);
+// Takes the ELEM_DOTTED flags back off everything in table
+void ako_elem_table_clear_dotted(ako_elem_t* table);
+// Has the table intern its keys in pool from now on, the table must be empty.
+void ako_elem_table_share_keys(ako_elem_t* table, intern_pool_t* pool);
+
+// Same as ako_elem_create but the element lives in doc's arena, doc can be NULL for the heap.
+ako_elem_t* ako_elem_create_in(ako_doc_t* doc, ako_type_t type);
+// Memory that goes away with the document, or from ako_malloc if doc is NULL.
+void* ako_doc_alloc(ako_doc_t* doc, size_t size);
+// Heap elements added to a document are destroyed with it unless they're removed first.
+void ako_doc_adopt(ako_doc_t* doc, ako_elem_t* elem);
+void ako_doc_forget(ako_doc_t* doc, ako_elem_t* elem);
+// Parses an ELEM_LAZY table or array, its own tables and arrays are left lazy
+void ako_doc_load(ako_elem_t* container);
+
+// The paths given to ako_parse_select as a tree, so a key only gets compared against the paths it could be part of.
+// Nodes are numbered with 0 as the root.
+typedef struct select_tree select_tree_t;
+#define SELECT_ALL ((size_t)-1)  // A path ended here, everything under it is wanted
+#define SELECT_NONE ((size_t)-2) // No path goes this way
+// NULL if any of the paths don't compile
+select_tree_t* select_tree_create(const char** paths, size_t n);
+void select_tree_destroy(select_tree_t* tree);
+// Where key leads from node
+size_t select_tree_key(const select_tree_t* tree, size_t node, const char* key, size_t key_len);
+// True if a path carries on into an array from node. Arrays are kept whole, skipping some of their values
+// would change the index of the rest.
+bool select_tree_wants_array(const select_tree_t* tree, size_t node);
@@ -0,0 +1,200 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include <ako/ako.h>
+#include <assert.h>
+#include <string.h>
+
+#include "lex/parser.h"
+#include "lex/token.h"
+#include "mem/dyn_array.h"
+#include "mem/dyn_string.h"
+
+// Smallest amount pulled from a new chunk when finishing off a token that got cut in half
+#define STREAM_MIN_TAKE 64
+
+struct ako_stream
+{
+    lexer_t lexer;
+    parse_stream_t* parser;
+    token_buf_t tokens;   // Lexed but not parsed yet, string and ident tokens point into strings
+    dyn_string_t strings; // Bytes of the string and ident tokens, chunks don't live long enough to point into
+    dyn_string_t carry;   // Start of a token that ran off the end of the last chunk
+    size_t carry_base;    // Where carry starts in the document
+    size_t fed;           // How many bytes we've been given so far
+    line_index_t lines;   // Chunks are gone by the time we need a line, so new lines are noted as they come in
+};
+
+ako_stream_t* ako_stream_begin()
+{
+    ako_stream_t* stream = ako_malloc(sizeof(ako_stream_t));
+    memset(stream, 0, sizeof(ako_stream_t));
+    line_index_init(&stream->lines, NULL, 0);
+    lexer_init(&stream->lexer, NULL, 0, false, &stream->lines);
+    stream->lexer.more_coming = true;
+    stream->parser = parse_stream_create(&stream->lines);
+    // Only ever holds what's between two feeds, so there's no point packing them
+    token_buf_init(&stream->tokens, true);
+    stream->strings = dyn_string_create(64);
+    stream->carry = dyn_string_create(STREAM_MIN_TAKE);
+    return stream;
+}
+
+// Lexes everything it can out of the current window
+static void _stream_lex(ako_stream_t* stream)
+{
+    token_t token;
+    while (lexer_next(&stream->lexer, &token))
+    {
+        if (token.type == AKO_TT_STRING || token.type == AKO_TT_IDENT)
+        {
+            // Keep our own copy, escapes are left as is for the parser to decode
+            size_t offset = stream->strings.size;
+            dyn_string_append_n(&stream->strings, stream->lexer.source + token.value_string.offset,
+                                token.value_string.length);
+            token.value_string.offset = offset;
+        }
+        token_buf_push(&stream->tokens, &token);
+    }
+}
+
+// Holds on to whatever the lexer didn't finish with
+static void _stream_keep_rest(ako_stream_t* stream)
+{
+    lexer_t* lexer = &stream->lexer;
+    size_t rest = lexer->source_len - lexer->index;
+    if (rest == 0)
+    {
+        return;
+    }
+
+    stream->carry.size = 0;
+    dyn_string_append_n(&stream->carry, lexer->source + lexer->index, rest);
+    stream->carry_base = lexer->base + lexer->index;
+}
+
+// Parses everything that's been lexed so far that it can, then lets go of the tokens and strings it's done with
+static void _stream_parse(ako_stream_t* stream)
+{
+    size_t used = parse_stream_run(stream->parser, &stream->tokens, stream->strings.data);
+    token_buf_drop(&stream->tokens, used);
+
+    // Strings are added in the same order as the tokens, the first one left is where the ones still needed start
+    size_t keep_from = stream->strings.size;
+    bool found = false;
+    for (size_t i = 0; i < stream->tokens.tokens.size; ++i)
+    {
+        token_t* token = dyn_array_get(&stream->tokens.tokens, i);
+        if (token->type == AKO_TT_STRING || token->type == AKO_TT_IDENT)
+        {
+            if (!found)
+            {
+                keep_from = token->value_string.offset;
+                found = true;
+            }
+            token->value_string.offset -= keep_from;
+        }
+    }
+    memmove(stream->strings.data, stream->strings.data + keep_from, stream->strings.size - keep_from);
+    stream->strings.size -= keep_from;
+}
+
+// Lexes a chunk into tokens, returns false on an error
+static bool _stream_lex_chunk(ako_stream_t* stream, const char* data, size_t length)
+{
+    lexer_t* lexer = &stream->lexer;
+    size_t chunk_base = stream->fed;
+    stream->fed += length;
+    line_index_add(&stream->lines, data, length, chunk_base);
+    size_t used = 0;
+
+    if (stream->carry.size > 0)
+    {
+        // Grow the cut off token with bytes from the new chunk until the lexer can finish it.
+        // Taking at least as much as we already have keeps this linear for really long strings.
+        size_t carried = stream->carry.size;
+        while (used < length)
+        {
+            size_t take = stream->carry.size > STREAM_MIN_TAKE ? stream->carry.size : STREAM_MIN_TAKE;
+            if (take > length - used)
+            {
+                take = length - used;
+            }
+            dyn_string_append_n(&stream->carry, data + used, take);
+            used += take;
+
+            lexer_set_window(lexer, stream->carry.data, stream->carry.size, stream->carry_base, true);
+            _stream_lex(stream);
+            if (lexer->err != NULL)
+            {
+                return false;
+            }
+
+            if (lexer->index > 0)
+            {
+                // Got past it, carry on from the matching spot in the chunk
+                assert(lexer->index >= carried);
+                used = lexer->index - carried;
+                break;
+            }
+        }
+
+        if (lexer->index == 0)
+        {
+            // Still not done, everything is in carry now
+            return true;
+        }
+        stream->carry.size = 0;
+    }
+
+    lexer_set_window(lexer, data + used, length - used, chunk_base + used, true);
+    _stream_lex(stream);
+    if (lexer->err != NULL)
+    {
+        return false;
+    }
+
+    _stream_keep_rest(stream);
+    return true;
+}
+
+bool ako_stream_feed(ako_stream_t* stream, const char* data, size_t length)
+{
+    assert(stream != NULL);
+    if (stream->lexer.err != NULL || parse_stream_ended(stream->parser))
+    {
+        // Anything after the root closes is ignored, same as ako_parse
+        return stream->lexer.err == NULL && !parse_stream_failed(stream->parser);
+    }
+    if (length == 0)
+    {
+        return true;
+    }
+
+    if (!_stream_lex_chunk(stream, data, length))
+    {
+        return false;
+    }
+    _stream_parse(stream);
+    return !parse_stream_failed(stream->parser);
+}
+
+ako_elem_t* ako_stream_finish(ako_stream_t* stream)
+{
+    assert(stream != NULL);
+    lexer_t* lexer = &stream->lexer;
+
+    if (lexer->err == NULL && !parse_stream_ended(stream->parser))
+    {
+        // Nothing else is coming, so whatever is left has to finish here
+        lexer_set_window(lexer, stream->carry.data, stream->carry.size, stream->fed - stream->carry.size, false);
+        _stream_lex(stream);
+    }
+    ako_elem_t* result = parse_stream_finish(stream->parser, &stream->tokens, stream->strings.data, lexer->err);
+
+    token_buf_destroy(&stream->tokens);
+    line_index_destroy(&stream->lines);
+    ako_free(stream->strings.data);
+    ako_free(stream->carry.data);
+    ako_free(stream);
+    return result;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#include "thread.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+static DWORD WINAPI thread_main(LPVOID param)
+{
+    thread_t* thread = param;
+    thread->func(thread->ud);
+    return 0;
+}
+
+bool thread_start(thread_t* thread, thread_func_t func, void* ud)
+{
+    thread->func = func;
+    thread->ud = ud;
+    thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+    return thread->handle != NULL;
+}
+
+void thread_join(thread_t* thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+size_t thread_cpu_count(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+size_t thread_fetch_inc(volatile size_t* counter)
+{
+#if defined(_WIN64)
+    return (size_t)InterlockedExchangeAdd64((volatile LONG64*)counter, 1);
+#else
+    return (size_t)InterlockedExchangeAdd((volatile LONG*)counter, 1);
+#endif
+}
+#else
+static void* thread_main(void* param)
+{
+    thread_t* thread = param;
+    thread->func(thread->ud);
+    return NULL;
+}
+
+bool thread_start(thread_t* thread, thread_func_t func, void* ud)
+{
+    thread->func = func;
+    thread->ud = ud;
+    return pthread_create(&thread->handle, NULL, thread_main, thread) == 0;
+}
+
+void thread_join(thread_t* thread)
+{
+    pthread_join(thread->handle, NULL);
+}
+
+size_t thread_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+size_t thread_fetch_inc(volatile size_t* counter)
+{
+    return __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+#endif
@@ -0,0 +1,31 @@
+// Copyright (c) 2025 Tuyuji, Reece Hagan
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+// Just enough threading for parsing on more than one core, pthreads everywhere but Windows.
+typedef void (*thread_func_t)(void* ud);
+
+typedef struct
+{
+#if defined(_WIN32)
+    void* handle;
+#else
+    pthread_t handle;
+#endif
+    thread_func_t func;
+    void* ud;
+} thread_t;
+
+// thread has to stay where it is until thread_join. False if the thread couldn't be made, func isn't called then.
+bool thread_start(thread_t* thread, thread_func_t func, void* ud);
+void thread_join(thread_t* thread);
+// How many cores we can run on, at least 1
+size_t thread_cpu_count(void);
+// Adds one to counter and gives back what it was before, safe to call from any number of threads at once
+size_t thread_fetch_inc(volatile size_t* counter);
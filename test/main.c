@@ -3,6 +3,7 @@
 #include <ako/ako.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 typedef struct
@@ -126,6 +127,26 @@ int basic_value_first()
     return 0;
 }
 
+int parse_slice()
+{
+    // Only the first part of the buffer should be read, "2xyz" would be a bad vector.
+    const char buffer[] = {'a', ' ', '1', ' ', 'b', ' ', '2', 'x', 'y', 'z'};
+    ako_elem_t* egg = ako_parse_n(buffer, 7);
+    ASSERT_ELEM(egg);
+
+    ako_elem_t* b = ako_elem_table_get(egg, "b");
+    ASSERT_ELEM(b);
+    if (ako_elem_get_int(b) != 2)
+    {
+        printf("Expected b to be 2\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    ako_elem_destroy(egg);
+    return 0;
+}
+
 int parse_float()
 {
     ako_elem_t* egg = ako_parse("a 1.0 b 42.0 miku 39.39");
@@ -158,6 +179,222 @@ int parse_string_esc()
     return 0;
 }
 
+int parse_string_mixed()
+{
+    ako_elem_t* egg = ako_parse("a \"plain\" b \"tab\\there\" \"quoted key\".c \"end\"");
+    ASSERT_ELEM(egg);
+
+    ASSERT_ELEM_STR(ako_elem_table_get(egg, "a"), "plain");
+    ASSERT_ELEM_STR(ako_elem_table_get(egg, "b"), "tab\there");
+    ASSERT_ELEM_STR(ako_elem_get(egg, "\"quoted key\".c"), "end");
+
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int parse_comments()
+{
+    ako_elem_t* egg = ako_parse("# a comment\twith a tab in it\n"
+                                "a 1 # trailing comment \"with a quote\n"
+                                "\t\tb \"long string that goes past a single simd block, \\\"escaped\\\" too\"\n"
+                                "# comment at the end with no new line");
+    ASSERT_ELEM(egg);
+
+    if (ako_elem_get_int(ako_elem_table_get(egg, "a")) != 1)
+    {
+        printf("Expected a to be 1\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+    ASSERT_ELEM_STR(ako_elem_table_get(egg, "b"),
+                    "long string that goes past a single simd block, \"escaped\" too");
+
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+static int assert_parse_error(const char* source)
+{
+    ako_elem_t* egg = ako_parse(source);
+    if (egg == NULL || !ako_elem_is_error(egg))
+    {
+        printf("Expected an error parsing: %s\n", source);
+        if (egg != NULL)
+        {
+            ako_elem_destroy(egg);
+        }
+        return 1;
+    }
+
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int parse_errors()
+{
+    // Lexer errors part way through, after the parser has already built some of the tree
+    if (assert_parse_error("a [ b 1 c [[ 1 2 ]] ] d $") != 0)
+        return 1;
+    if (assert_parse_error("a [ b 5xz ]") != 0)
+        return 1;
+    // Running out of tokens
+    if (assert_parse_error("a.b") != 0)
+        return 1;
+    if (assert_parse_error("a [ b 1") != 0)
+        return 1;
+    if (assert_parse_error("a [[ 1 2") != 0)
+        return 1;
+    // Dotted key going through something that isn't a table
+    if (assert_parse_error("a 1 a.b 2") != 0)
+        return 1;
+    return 0;
+}
+
+int parse_depth()
+{
+    // Way deeper than any recursive parser would survive
+    const size_t deep = 100000;
+    char* source = malloc(deep * 3 + 1);
+    for (size_t i = 0; i < deep; ++i)
+    {
+        memcpy(source + i * 3, "[[ ", 3);
+    }
+    source[deep * 3] = '\0';
+
+    ako_elem_t* egg = ako_parse(source);
+    free(source);
+    if (egg == NULL || !ako_elem_is_error(egg) || strstr(ako_elem_get_string(egg), "max depth") == NULL)
+    {
+        printf("Expected the max depth to be hit\n");
+        if (egg != NULL)
+        {
+            ako_elem_destroy(egg);
+        }
+        return 1;
+    }
+    ako_elem_destroy(egg);
+
+    // Root counts as one, so a has room for exactly one more
+    ako_parse_opts_t opts = {.max_depth = 3};
+    const char* fits = "a [ b [[ 1 ]] ]";
+    egg = ako_parse_ex(fits, strlen(fits), &opts);
+    ASSERT_ELEM(egg);
+    if (ako_elem_get_int(ako_elem_array_get(ako_elem_get(egg, "a.b"), 0)) != 1)
+    {
+        printf("Nested array parsed wrong\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+    ako_elem_destroy(egg);
+
+    const char* too_deep = "a [ b [[ [ c 1 ] ]] ]";
+    egg = ako_parse_ex(too_deep, strlen(too_deep), &opts);
+    if (egg == NULL || !ako_elem_is_error(egg) ||
+        strcmp(ako_elem_get_string(egg), "Nested deeper than the max depth of 3 at 1:10") != 0)
+    {
+        printf("Expected the max depth of 3 to be hit\n");
+        if (egg != NULL)
+        {
+            ako_elem_destroy(egg);
+        }
+        return 1;
+    }
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int parse_numbers()
+{
+    ako_elem_t* egg = ako_parse("a 0.1 b 2.2250738585072014 c 3.14159265358979323846264338327950288 d 9223372036854775807 "
+                                "e 010 f 1.");
+    ASSERT_ELEM(egg);
+
+    if (ako_elem_get_float(ako_elem_table_get(egg, "a")) != 0.1 ||
+        ako_elem_get_float(ako_elem_table_get(egg, "b")) != 2.2250738585072014 ||
+        ako_elem_get_float(ako_elem_table_get(egg, "c")) != 3.14159265358979323846264338327950288 ||
+        ako_elem_get_float(ako_elem_table_get(egg, "f")) != 1.0)
+    {
+        printf("Float parsed to the wrong value\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    // Ints are always decimal, leading zeros don't make it octal
+    if (ako_elem_get_int(ako_elem_table_get(egg, "d")) != INT64_MAX ||
+        ako_elem_get_int(ako_elem_table_get(egg, "e")) != 10)
+    {
+        printf("Int parsed to the wrong value\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+    ako_elem_destroy(egg);
+
+    if (assert_parse_error("a 9223372036854775808") != 0)
+        return 1;
+    if (assert_parse_error("a 1.2.3") != 0)
+        return 1;
+    return 0;
+}
+
+int parse_error_locations()
+{
+    const char* sources[] = {"a 1\nb 2\n  c $", "a 1\n\nb [[ 1\n 2x ]]", "# comment\nv 1x2x3x4x5"};
+    const char* expected[] = {"Unknown character $ at 3:5", "Failed to parse vector at 4:3",
+                              "Vector size is greater than 4 at 2:3"};
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i)
+    {
+        ako_elem_t* egg = ako_parse(sources[i]);
+        if (egg == NULL || !ako_elem_is_error(egg) || strcmp(ako_elem_get_string(egg), expected[i]) != 0)
+        {
+            printf("Expected error: %s\n", expected[i]);
+            if (egg != NULL)
+            {
+                ako_elem_destroy(egg);
+            }
+            return 1;
+        }
+        ako_elem_destroy(egg);
+    }
+    return 0;
+}
+
+int parse_escaped_keys()
+{
+    ako_elem_t* egg = ako_parse("\"a\\\"b\".c 1 \"a\\\"b\".d 2");
+    ASSERT_ELEM(egg);
+
+    ako_elem_t* ab = ako_elem_table_get(egg, "a\"b");
+    ASSERT_ELEM(ab);
+    if (ako_elem_table_get_length(egg) != 1 || ako_elem_table_get_length(ab) != 2)
+    {
+        printf("Expected one table with two values\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int parse_utf8_keys()
+{
+    // Non ASCII bytes are part of identifiers
+    ako_elem_t* egg = ako_parse("曲.名前 \"ネトゲ廃人シュプレヒコール\" café_1 +");
+    ASSERT_ELEM(egg);
+
+    ASSERT_ELEM_STR(ako_elem_get(egg, "曲.名前"), "ネトゲ廃人シュプレヒコール");
+    ako_elem_t* cafe = ako_elem_table_get(egg, "café_1");
+    if (cafe == NULL || !ako_elem_get_bool(cafe))
+    {
+        printf("Expected café_1 to be true\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    ako_elem_destroy(egg);
+    return 0;
+}
+
 int parse_short_type()
 {
     ako_elem_t* egg = ako_parse("mi &ku window.width 55");
@@ -287,22 +524,1204 @@ int util_get()
     return 0;
 }
 
-static test_t tests[] = {
-    {"Basic parsing", &basic_parse},
-    {"Basic value first parsing", &basic_value_first},
-    {"Float parsing", &parse_float},
-    {"String escape parsing", &parse_string_esc},
-    {"Short type parsing", &parse_short_type},
-    {"Multi short type parsing", &parse_multi_short_type},
+int big_table()
+{
+    // Big enough that lookups go through the hash index
+    ako_elem_t* table = ako_elem_create(AT_TABLE);
+    char key[32];
+    for (int i = 0; i < 1000; ++i)
+    {
+        snprintf(key, sizeof(key), "key%d", i);
+        ako_elem_table_add(table, key, ako_elem_create_int(i));
+    }
+    // Duplicates are found in the order they were added
+    ako_elem_table_add(table, "key10", ako_elem_create_int(-1));
 
-    // Serialisation tests
-    {"Basic serialisation", &basic_serialise},
+    for (int i = 0; i < 1000; ++i)
+    {
+        snprintf(key, sizeof(key), "key%d", i);
+        ako_elem_t* value = ako_elem_table_get(table, key);
+        if (value == NULL || ako_elem_get_int(value) != i)
+        {
+            printf("Failed to find %s\n", key);
+            ako_elem_destroy(table);
+            return 1;
+        }
+    }
+    if (ako_elem_table_contains(table, "key1000") || ako_elem_table_get(table, "key") != NULL)
+    {
+        printf("Found a key that was never added\n");
+        ako_elem_destroy(table);
+        return 1;
+    }
 
-    // Unicode
-    // {"Unicode parsing", &unicode_parse},
+    // Keys after a removed one shift down, so the index has to keep up
+    ako_elem_table_remove(table, "key500");
+    if (ako_elem_table_contains(table, "key500") || ako_elem_get_int(ako_elem_table_get(table, "key501")) != 501 ||
+        ako_elem_get_int(ako_elem_table_get(table, "key999")) != 999)
+    {
+        printf("Lookup wrong after remove\n");
+        ako_elem_destroy(table);
+        return 1;
+    }
+    if (strcmp(ako_elem_table_get_key_at(table, 0), "key0") != 0 ||
+        strcmp(ako_elem_table_get_key_at(table, 998), "key999") != 0)
+    {
+        printf("Insertion order not kept\n");
+        ako_elem_destroy(table);
+        return 1;
+    }
+    ako_elem_destroy(table);
 
-    // Utils
-    {"Utility Get", &util_get},
+    // Dotted keys look up their parent table every time
+    char source[8192];
+    size_t length = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        length += snprintf(source + length, sizeof(source) - length, "t%d.a%d %d t%d.b %d ", i % 50, i, i, i % 50, i);
+    }
+    ako_elem_t* egg = ako_parse(source);
+    ASSERT_ELEM(egg);
+    if (ako_elem_table_get_length(egg) != 50 || ako_elem_table_get_length(ako_elem_table_get(egg, "t7")) != 8 ||
+        ako_elem_get_int(ako_elem_get(egg, "t49.b")) != 49)
+    {
+        printf("Dotted keys went to the wrong tables\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int interned_keys()
+{
+    ako_elem_t* egg = ako_parse("a [ name \"a\" port 1 ] b [ name \"b\" port 2 ] c.name \"c\"");
+    ASSERT_ELEM(egg);
+
+    // Same key in different tables is the same string
+    ako_elem_t* a = ako_elem_table_get(egg, "a");
+    ako_elem_t* b = ako_elem_table_get(egg, "b");
+    ako_elem_t* c = ako_elem_table_get(egg, "c");
+    if (ako_elem_table_get_key_at(a, 0) != ako_elem_table_get_key_at(b, 0) ||
+        ako_elem_table_get_key_at(a, 0) != ako_elem_table_get_key_at(c, 0))
+    {
+        printf("Keys weren't shared\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    ako_key_t name = ako_key_find(egg, "name");
+    ako_key_t port = ako_key_find(c, "port");
+    if (name == NULL || port == NULL || ako_key_find(egg, "host") != NULL ||
+        strcmp(ako_key_get_string(name), "name") != 0)
+    {
+        printf("Key handles are wrong\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    ASSERT_ELEM_STR(ako_elem_table_get_key(b, name), "b");
+    ASSERT_ELEM_STR(ako_elem_table_get_key(c, name), "c");
+    if (ako_elem_get_int(ako_elem_table_get_key(a, port)) != 1 || ako_elem_table_get_key(c, port) != NULL)
+    {
+        printf("Lookup by handle failed\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+
+    // Tables that weren't parsed still work, just by comparing strings
+    ako_elem_t* table = ako_elem_create(AT_TABLE);
+    ako_elem_table_add(table, "name", ako_elem_create_string("made"));
+    ASSERT_ELEM_STR(ako_elem_table_get_key(table, name), "made");
+    if (ako_key_find(table, "name") != NULL)
+    {
+        printf("Only parsed tables have handles\n");
+        ako_elem_destroy(table);
+        ako_elem_destroy(egg);
+        return 1;
+    }
+    ako_elem_destroy(table);
+
+    // Added after parsing go in the pool too
+    ako_elem_table_add(a, "host", ako_elem_create_int(3));
+    if (ako_elem_get_int(ako_elem_table_get_key(a, ako_key_find(b, "host"))) != 3)
+    {
+        printf("Added key wasn't interned\n");
+        ako_elem_destroy(egg);
+        return 1;
+    }
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int doc_parse()
+{
+    const char* source = "name \"ako\" window [ size 800x600 title \"hi\" ] list [[ 1 2 3 ]] kind &type.a";
+    ako_doc_t* doc = ako_doc_parse(source, strlen(source), NULL);
+    ako_elem_t* root = ako_doc_get_root(doc);
+    if (root == NULL || ako_elem_is_error(root))
+    {
+        printf("Document failed to parse\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+
+    ASSERT_ELEM_STR(ako_elem_table_get(root, "name"), "ako");
+    ASSERT_ELEM_STR(ako_elem_get(root, "window.title"), "hi");
+
+    // Editing in place
+    ako_elem_t* window = ako_elem_table_get(root, "window");
+    ako_elem_set_string(ako_elem_table_get(window, "title"), "changed");
+    ako_elem_set_int(ako_elem_table_get(root, "name"), 5);
+    ako_elem_array_add(ako_elem_table_get(root, "list"), ako_elem_create_int(4));
+    ako_elem_table_remove(window, "size");
+
+    // Things made on the heap go to the document
+    ako_elem_t* extra = ako_elem_table_add(root, "extra", ako_elem_create(AT_TABLE));
+    ako_elem_table_add(extra, "a", ako_elem_create_string("a"));
+    ako_elem_table_add(root, "gone", ako_elem_create_string("gone"));
+    ako_elem_table_remove(root, "gone");
+
+    ASSERT_ELEM_STR(ako_elem_get(root, "window.title"), "changed");
+    ASSERT_ELEM_STR(ako_elem_get(root, "extra.a"), "a");
+    if (ako_elem_get_int(ako_elem_table_get(root, "name")) != 5 ||
+        ako_elem_array_get_length(ako_elem_table_get(root, "list")) != 4 || ako_elem_table_contains(window, "size") ||
+        ako_elem_table_contains(root, "gone"))
+    {
+        printf("Document edits went wrong\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+
+    char* err = NULL;
+    const char* out = ako_serialize(root, &err, ASF_NONE);
+    if (out == NULL || strstr(out, "\"changed\"") == NULL)
+    {
+        printf("Document didn't serialise\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    ako_free_string(out);
+    ako_doc_destroy(doc);
+
+    // Errors still come back through the root
+    doc = ako_doc_parse("a [ b 1", 7, NULL);
+    if (ako_doc_get_root(doc) == NULL || !ako_elem_is_error(ako_doc_get_root(doc)))
+    {
+        printf("Expected a document error\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    ako_doc_destroy(doc);
+    return 0;
+}
+
+int lazy_doc()
+{
+    const char* source = "name \"ako\" window [ size 800x600 title \"] [[\" # ]]\n"
+                         "  inner [ list [[ 1 2 [ a 1 ] ]] ] ] +window.extra list [[ [[ 1 ]] [ b ; ] ]]";
+    ako_doc_t* eager = ako_doc_parse(source, strlen(source), NULL);
+    ako_doc_t* doc = ako_doc_parse_lazy(source, strlen(source), NULL);
+    ako_elem_t* root = ako_doc_get_root(doc);
+    if (root == NULL || ako_elem_is_error(root))
+    {
+        printf("Lazy document failed to parse\n");
+        ako_doc_destroy(eager);
+        ako_doc_destroy(doc);
+        return 1;
+    }
+
+    ASSERT_ELEM_STR(ako_elem_get(root, "window.title"), "] [[");
+    if (ako_elem_get_int(ako_elem_get(root, "window.inner.list.2.a")) != 1 ||
+        !ako_elem_get_bool(ako_elem_get(root, "window.extra")))
+    {
+        printf("Lazy lookups went wrong\n");
+        ako_doc_destroy(eager);
+        ako_doc_destroy(doc);
+        return 1;
+    }
+
+    // Loaded or not, it all comes out the same as parsing it all at once
+    char* err = NULL;
+    const char* lazy_out = ako_serialize(root, &err, ASF_NONE);
+    const char* eager_out = ako_serialize(ako_doc_get_root(eager), &err, ASF_NONE);
+    bool same = lazy_out != NULL && eager_out != NULL && strcmp(lazy_out, eager_out) == 0;
+    ako_free_string(lazy_out);
+    ako_free_string(eager_out);
+    ako_doc_destroy(doc);
+    ako_doc_destroy(eager);
+    if (!same || ako_doc_get_error(doc = ako_doc_parse_lazy(source, strlen(source), NULL)) != NULL)
+    {
+        printf("Lazy document doesn't match\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+
+    // Keys deep down that nothing has looked at yet can still be found
+    root = ako_doc_get_root(doc);
+    ako_key_t key = ako_key_find(root, "a");
+    if (key == NULL || ako_elem_get_int(ako_elem_table_get_key(ako_elem_get(root, "window.inner.list.2"), key)) != 1)
+    {
+        printf("Lazy key wasn't found\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    ako_doc_destroy(doc);
+
+    // Mistakes inside a table only come up once it's loaded
+    doc = ako_doc_parse_lazy("a 1 b [ c [ d ] ] e 2", 21, NULL);
+    root = ako_doc_get_root(doc);
+    if (root == NULL || ako_elem_is_error(root) || ako_elem_get_int(ako_elem_table_get(root, "e")) != 2 ||
+        ako_doc_get_error(doc) != NULL)
+    {
+        printf("Expected the broken table to be left for later\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    if (ako_elem_get(root, "b.c.d") != NULL || ako_elem_table_get_length(ako_elem_get(root, "b.c")) != 0 ||
+        ako_doc_get_error(doc) == NULL)
+    {
+        printf("Expected an error loading the broken table\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    ako_doc_destroy(doc);
+
+    // Unless they're checked up front
+    ako_parse_opts_t opts = {.check_skipped = true};
+    doc = ako_doc_parse_lazy("a 1 b [ c [ d ] ] e 2", 21, &opts);
+    if (ako_doc_get_root(doc) == NULL || !ako_elem_is_error(ako_doc_get_root(doc)))
+    {
+        printf("Expected the broken table to be checked\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    ako_doc_destroy(doc);
+
+    // Dotted keys clashing with something inside a table that isn't loaded yet too
+    const char* clash = "a [ b 1 b.c 2 ] z 3";
+    ako_elem_t* expected_err = ako_parse(clash);
+    doc = ako_doc_parse_lazy(clash, strlen(clash), &opts);
+    ako_elem_t* doc_root = ako_doc_get_root(doc);
+    same = doc_root != NULL && ako_elem_is_error(doc_root) &&
+           strcmp(ako_elem_get_string(doc_root), ako_elem_get_string(expected_err)) == 0;
+    ako_elem_destroy(expected_err);
+    ako_doc_destroy(doc);
+    if (!same)
+    {
+        printf("Expected the same error as ako_parse for the clashing dotted key\n");
+        return 1;
+    }
+
+    // Depth still counts from the root
+    opts = (ako_parse_opts_t){.max_depth = 2};
+    doc = ako_doc_parse_lazy("a [ b [ c 1 ] ]", 15, &opts);
+    if (ako_elem_get(ako_doc_get_root(doc), "a.b.c") != NULL || ako_doc_get_error(doc) == NULL)
+    {
+        printf("Expected the max depth to be hit\n");
+        ako_doc_destroy(doc);
+        return 1;
+    }
+    ako_doc_destroy(doc);
+    return 0;
+}
+
+int inline_entries()
+{
+    char source[1024] = "list [[";
+    for (int i = 0; i < 100; ++i)
+    {
+        char num[16];
+        snprintf(num, sizeof(num), " %d", i);
+        strcat(source, num);
+    }
+    strcat(source, " ]] t [ a 1 b 2 ]");
+
+    ako_elem_t* root = ako_parse(source);
+    ako_elem_t* list = ako_elem_table_get(root, "list");
+    ako_elem_t* fifth = ako_elem_array_get(list, 5);
+
+    // Adding more can't move what's already there
+    ako_elem_t* added = ako_elem_create_int(100);
+    if (ako_elem_array_add(list, added) != added)
+    {
+        printf("Add didn't hand back the same element\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+    for (int i = 101; i < 300; ++i)
+    {
+        ako_elem_array_add(list, ako_elem_create_int(i));
+    }
+    if (ako_elem_array_get(list, 5) != fifth || ako_elem_array_get(list, 100) != added)
+    {
+        printf("Entries moved\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    // Removing shifts everything after it down
+    ako_elem_array_remove(list, 0);
+    ako_elem_array_remove(list, 298);
+    for (size_t i = 0; i < ako_elem_array_get_length(list); ++i)
+    {
+        if (ako_elem_get_int(ako_elem_array_get(list, i)) != (ako_int)i + 1)
+        {
+            printf("Entry %zu is wrong after removing\n", i);
+            ako_elem_destroy(root);
+            return 1;
+        }
+    }
+    while (ako_elem_array_get_length(list) > 0)
+    {
+        ako_elem_array_remove(list, ako_elem_array_get_length(list) - 1);
+    }
+    ako_elem_array_add(list, ako_elem_create_int(7));
+    if (ako_elem_get_int(ako_elem_array_get(list, 0)) != 7)
+    {
+        printf("Couldn't add after emptying\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    // Changing type gets rid of the entries
+    ako_elem_t* t = ako_elem_table_get(root, "t");
+    ako_elem_set_type(t, AT_ARRAY);
+    if (ako_elem_array_get_length(t) != 0)
+    {
+        printf("Table entries carried over to the array\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+    ako_elem_array_add(t, ako_elem_create_int(1));
+    ASSERT_ELEM(ako_elem_get(root, "t.0"));
+
+    ako_elem_destroy(root);
+    return 0;
+}
+
+int packed_arrays()
+{
+    const char* source = "ints [[ 1 2 3 4 5 6 7 8 9 10 ]] floats [[ 0.5 1.5 2.5 ]] mixed [[ 1 2.5 ]] size 800x600";
+    ako_elem_t* root = ako_parse(source);
+    ako_elem_t* ints = ako_elem_table_get(root, "ints");
+    ako_elem_t* floats = ako_elem_table_get(root, "floats");
+    ako_elem_t* mixed = ako_elem_table_get(root, "mixed");
+
+    const ako_int* packed_ints = ako_elem_array_ints(ints);
+    const ako_float* packed_floats = ako_elem_array_floats(floats);
+    if (packed_ints == NULL || packed_floats == NULL || ako_elem_array_floats(ints) != NULL ||
+        ako_elem_array_ints(mixed) != NULL || ako_elem_array_floats(mixed) != NULL)
+    {
+        printf("Arrays weren't packed right\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+    if (packed_ints[9] != 10 || packed_floats[2] != 2.5 || ako_elem_array_get_length(ints) != 10)
+    {
+        printf("Packed numbers are wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    ako_int out[16];
+    ako_float out_f[4];
+    if (ako_elem_array_get_ints(ints, out, 16) != 10 || out[0] != 1 || ako_elem_array_get_floats(ints, out_f, 4) != 0 ||
+        ako_elem_array_get_ints(mixed, out, 16) != 1 || ako_elem_array_get_floats(floats, out_f, 2) != 2 ||
+        out_f[1] != 1.5)
+    {
+        printf("Bulk copies are wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    // Written out without having to unpack
+    const char* serialised = ako_serialize(root, NULL, ASF_NONE);
+    if (strstr(serialised, "800x600") == NULL || ako_elem_array_ints(ako_elem_table_get(root, "ints")) == NULL)
+    {
+        printf("Packed arrays didn't serialise: %s\n", serialised);
+        ako_free_string(serialised);
+        ako_elem_destroy(root);
+        return 1;
+    }
+    ako_free_string(serialised);
+
+    // Numbers past 32 bits come back whole
+    ako_elem_t* big = ako_parse("n 5000000000 list [[ 4294967296 5000000000 ]]");
+    serialised = ako_serialize(big, NULL, ASF_NONE);
+    ako_elem_t* again = ako_parse(serialised);
+    const ako_int* big_ints = ako_elem_array_ints(ako_elem_table_get(again, "list"));
+    bool whole = big_ints != NULL && big_ints[0] == 4294967296LL && big_ints[1] == 5000000000LL &&
+                 ako_elem_get_int(ako_elem_table_get(again, "n")) == 5000000000LL;
+    ako_free_string(serialised);
+    ako_elem_destroy(again);
+    ako_elem_destroy(big);
+    if (!whole)
+    {
+        printf("Big packed numbers didn't round trip\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    // Taking an element out unpacks it
+    ako_elem_array_remove(ints, 0);
+    if (ako_elem_get_int(ako_elem_array_get(ints, 0)) != 2 || ako_elem_array_ints(ints) != NULL)
+    {
+        printf("Unpacking went wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+    ako_elem_array_add(ints, ako_elem_create_string("not a number"));
+    if (ako_elem_array_get_ints(ints, out, 16) != 9 || out[8] != 10)
+    {
+        printf("Bulk copy of an unpacked array is wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    ako_elem_destroy(root);
+    return 0;
+}
+
+int parse_vectors()
+{
+    ako_elem_t* root = ako_parse("size 800x600 pos 1.5x2x3 color 1x0.5x0.25x1");
+    ako_elem_t* size = ako_elem_table_get(root, "size");
+    ako_elem_t* pos = ako_elem_table_get(root, "pos");
+
+    ako_vec2_t v2 = ako_elem_get_vec2(size);
+    ako_vec3_t v3 = ako_elem_get_vec3(pos);
+    ako_vec4_t v4 = ako_elem_get_vec4(ako_elem_table_get(root, "color"));
+    if (v2.x != 800 || v2.y != 600 || v3.x != 1.5 || v3.z != 3 || v4.y != 0.5 || v4.w != 1)
+    {
+        printf("Vector components are wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    const ako_int* ints = ako_elem_array_ints(size);
+    ako_float floats[3];
+    if (ints == NULL || ints[1] != 600 || ako_elem_array_get_length(size) != 2 || ako_elem_array_ints(pos) != NULL ||
+        ako_elem_array_get_floats(pos, floats, 3) != 1 || floats[0] != 1.5)
+    {
+        printf("Vector numbers are wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    const char* serialised = ako_serialize(root, NULL, ASF_NONE);
+    if (strstr(serialised, "size 800x600") == NULL || strstr(serialised, "x2x3") == NULL)
+    {
+        printf("Vectors didn't serialise: %s\n", serialised);
+        ako_free_string(serialised);
+        ako_elem_destroy(root);
+        return 1;
+    }
+    ako_free_string(serialised);
+
+    // Components past 32 bits come back whole
+    ako_elem_t* big = ako_parse("v 5000000000x4294967296");
+    serialised = ako_serialize(big, NULL, ASF_NONE);
+    ako_elem_t* again = ako_parse(serialised);
+    ako_vec2_t big_v2 = ako_elem_get_vec2(ako_elem_table_get(again, "v"));
+    ako_free_string(serialised);
+    ako_elem_destroy(again);
+    ako_elem_destroy(big);
+    if (big_v2.x != 5000000000.0 || big_v2.y != 4294967296.0)
+    {
+        printf("Big vector components didn't round trip\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    // Still works as an array
+    if (ako_elem_get_int(ako_elem_array_get(pos, 1)) != 2 || ako_elem_get_float(ako_elem_array_get(pos, 0)) != 1.5)
+    {
+        printf("Vector didn't unpack\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+    ako_elem_array_remove(size, 0);
+    ako_elem_array_add(size, ako_elem_create_float(2.5));
+    v2 = ako_elem_get_vec2(size);
+    if (v2.x != 600 || v2.y != 2.5)
+    {
+        printf("Vector edits went wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    ako_elem_destroy(root);
+    return 0;
+}
+
+int compiled_paths()
+{
+    ako_elem_t* root =
+        ako_parse("window [ size 800x600 \"the title\" \"hi\" ] list [[ [ name \"a\" ] [ name \"b\" ] ]]");
+    ako_path_t* width = ako_path_compile("window.size.0");
+    ako_path_t* title = ako_path_compile("window.\"the title\"");
+    ako_path_t* name = ako_path_compile("list.1.name");
+    ako_path_t* missing = ako_path_compile("list.5.name");
+    if (width == NULL || title == NULL || name == NULL || missing == NULL)
+    {
+        printf("Path didn't compile\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    ASSERT_ELEM_STR(ako_elem_get_path(root, title), "hi");
+    ASSERT_ELEM_STR(ako_elem_get_path(root, name), "b");
+    if (ako_elem_get_int(ako_elem_get_path(root, width)) != 800 || ako_elem_get_path(root, missing) != NULL ||
+        ako_elem_get_path(ako_elem_table_get(root, "list"), title) != NULL)
+    {
+        printf("Path lookups are wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    if (ako_path_compile("") != NULL || ako_path_compile("a.") != NULL || ako_path_compile("a..b") != NULL ||
+        ako_path_compile("a.[") != NULL)
+    {
+        printf("Bad paths compiled\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+
+    // All at once, sharing the walk down to window and list
+    const char* paths[] = {"window.size.1", "list.0.name", "window.\"the title\"", "list.1.name", "list.2.name", "a."};
+    ako_elem_t* found[6];
+    if (ako_elem_get_many(root, paths, 6, found) != 4 || found[4] != NULL || found[5] != NULL ||
+        ako_elem_get_int(found[0]) != 600)
+    {
+        printf("Batch lookup is wrong\n");
+        ako_elem_destroy(root);
+        return 1;
+    }
+    ASSERT_ELEM_STR(found[1], "a");
+    ASSERT_ELEM_STR(found[2], "hi");
+    ASSERT_ELEM_STR(found[3], "b");
+
+    ako_path_destroy(width);
+    ako_path_destroy(title);
+    ako_path_destroy(name);
+    ako_path_destroy(missing);
+    ako_elem_destroy(root);
+    return 0;
+}
+
+// Writes every event into a string so the order can be checked
+typedef struct
+{
+    char text[512];
+    size_t size;
+    size_t stop_after; // Stops once this many events have come in, 0 to never stop
+    size_t count;
+} event_log_t;
+
+static bool log_event(void* ud, const char* fmt, const char* str, size_t length)
+{
+    event_log_t* log = ud;
+    log->size += (size_t)snprintf(log->text + log->size, sizeof(log->text) - log->size, fmt, (int)length, str);
+    log->count++;
+    return log->stop_after == 0 || log->count < log->stop_after;
+}
+
+static bool log_key(void* ud, const char* key, size_t length)
+{
+    return log_event(ud, "%.*s= ", key, length);
+}
+
+static bool log_table_begin(void* ud)
+{
+    return log_event(ud, "{ %.*s", "", 0);
+}
+
+static bool log_table_end(void* ud)
+{
+    return log_event(ud, "} %.*s", "", 0);
+}
+
+static bool log_array_begin(void* ud)
+{
+    return log_event(ud, "[ %.*s", "", 0);
+}
+
+static bool log_array_end(void* ud)
+{
+    return log_event(ud, "] %.*s", "", 0);
+}
+
+static bool log_bool(void* ud, bool value)
+{
+    return log_event(ud, "%.*s ", value ? "T" : "F", 1);
+}
+
+static bool log_int(void* ud, ako_int value)
+{
+    char buf[32];
+    int length = snprintf(buf, sizeof(buf), "%lld", (long long)value);
+    return log_event(ud, "%.*s ", buf, (size_t)length);
+}
+
+static bool log_float(void* ud, ako_float value)
+{
+    char buf[32];
+    int length = snprintf(buf, sizeof(buf), "%g", value);
+    return log_event(ud, "%.*s ", buf, (size_t)length);
+}
+
+static bool log_string(void* ud, const char* str, size_t length)
+{
+    return log_event(ud, "'%.*s' ", str, length);
+}
+
+static bool log_shorttype(void* ud, const char* str, size_t length)
+{
+    return log_event(ud, "&%.*s ", str, length);
+}
+
+int parse_events()
+{
+    // on_null is left out on purpose
+    ako_handler_t handler = {log_key,         log_table_begin, log_table_end, log_array_begin,
+                             log_array_end,   NULL,            log_bool,      log_int,
+                             log_float,       log_string,      log_shorttype};
+    const char* source = "a.b 1 +on name \"x\\\"y\" list [[ 1 2.5 1x2.5 [ k 3 ] ]] t &foo.bar ;nothing";
+    const char* expected = "{ a= b= 1 on= T name= 'x\"y' list= [ 1 2.5 [ 1 2.5 ] { k= 3 } ] t= &foo.bar nothing= } ";
+
+    event_log_t log = {0};
+    ako_elem_t* err = ako_parse_events(source, strlen(source), &handler, &log);
+    if (err != NULL || strcmp(log.text, expected) != 0)
+    {
+        printf("Got events: %s\nExpected: %s\n", log.text, expected);
+        return 1;
+    }
+
+    // Parse errors come back the same as ako_parse
+    memset(&log, 0, sizeof(log));
+    err = ako_parse_events("a [[ 1 2", 8, &handler, &log);
+    if (err == NULL || !ako_elem_is_error(err))
+    {
+        printf("Expected an error from an unclosed array\n");
+        return 1;
+    }
+    ako_elem_destroy(err);
+
+    // Dotted keys going into something that isn't a table fail the same way, even with nothing being built
+    const char* dotted[] = {"a [ b 1 b.c 2 ] z 3", "a 1 a.b 2", "+a a.b 1", "a [ b 1 ] a.b.c 2", "a [[ ]] a.b 1",
+                            "a [ x 1 ] a [ y 2 ] a.y.z 3"};
+    ako_handler_t nothing = {0};
+    for (size_t i = 0; i < sizeof(dotted) / sizeof(dotted[0]); ++i)
+    {
+        ako_elem_t* expected_err = ako_parse(dotted[i]);
+        err = ako_parse_events(dotted[i], strlen(dotted[i]), &nothing, NULL);
+        bool same = ako_elem_is_error(expected_err)
+                        ? err != NULL && strcmp(ako_elem_get_string(err), ako_elem_get_string(expected_err)) == 0
+                        : err == NULL;
+        ako_elem_destroy(expected_err);
+        if (err != NULL)
+        {
+            ako_elem_destroy(err);
+        }
+        if (!same)
+        {
+            printf("Events and ako_parse disagree on: %s\n", dotted[i]);
+            return 1;
+        }
+    }
+
+    // Returning false stops everything
+    memset(&log, 0, sizeof(log));
+    log.stop_after = 3;
+    err = ako_parse_events(source, strlen(source), &handler, &log);
+    if (err == NULL || strcmp(ako_elem_get_string(err), "Stopped by the handler at 1:3") != 0 || log.count != 3)
+    {
+        printf("Handler wasn't stopped, got: %s\n", log.text);
+        return 1;
+    }
+    ako_elem_destroy(err);
+    return 0;
+}
+
+int parse_select()
+{
+    const char* source = "db [ primary [ host \"a\" port 5432 ] replica [ host \"b\" port 5433 ] ]\n"
+                         "web [ title \"]] # [[\" routes [[ [ path \"/\" ] ]] ] # ]]\n"
+                         "cache.size 64 cache.ttl 30 +debug list [[ 1 2 3 ]]";
+    const char* paths[] = {"db.primary", "cache.size", "list.1"};
+
+    ako_elem_t* selected = ako_parse_select(source, strlen(source), paths, 3);
+    ASSERT_ELEM(selected);
+    ako_elem_t* expected_elem = ako_parse("db [ primary [ host \"a\" port 5432 ] ] cache [ size 64 ] list [[ 1 2 3 ]]");
+    const char* expected = ako_serialize(expected_elem, NULL, ASF_NONE);
+    const char* actual = ako_serialize(selected, NULL, ASF_NONE);
+    int result = strcmp(expected, actual);
+    if (result != 0)
+    {
+        printf("Selected: %s\nExpected: %s\n", actual, expected);
+    }
+    ako_free_string(expected);
+    ako_free_string(actual);
+    ako_elem_destroy(expected_elem);
+    ako_elem_destroy(selected);
+    if (result != 0)
+    {
+        return 1;
+    }
+
+    // Mistakes in skipped parts are only noticed when asked for, unless the brackets don't match
+    const char* bad = "keep 1 skip [ a 1 2 ]";
+    const char* keep = "keep";
+    ako_elem_t* egg = ako_parse_select(bad, strlen(bad), &keep, 1);
+    ASSERT_ELEM(egg);
+    ako_elem_destroy(egg);
+
+    ako_parse_opts_t opts = {.check_skipped = true};
+    egg = ako_parse_select_ex(bad, strlen(bad), &keep, 1, &opts);
+    if (egg == NULL || !ako_elem_is_error(egg))
+    {
+        printf("Expected an error from the skipped table\n");
+        return 1;
+    }
+    ako_elem_destroy(egg);
+
+    // The first entry for a key wins even when the path can't go through it
+    const char* dups[] = {"a 1 a [ b 2 ] z [ q 1 ]", "+a a [ b 2 ]", "a [[ 1 ]] a [ b 2 ]", "a [ b 1 ] a [ b 2 ]"};
+    const char* a_b = "a.b";
+    for (size_t i = 0; i < sizeof(dups) / sizeof(dups[0]); ++i)
+    {
+        ako_elem_t* whole = ako_parse(dups[i]);
+        egg = ako_parse_select(dups[i], strlen(dups[i]), &a_b, 1);
+        ako_elem_t* expected_b = ako_elem_get(whole, "a.b");
+        ako_elem_t* actual_b = ako_elem_get(egg, "a.b");
+        bool same = expected_b == NULL ? actual_b == NULL
+                                       : actual_b != NULL && ako_elem_get_int(actual_b) == ako_elem_get_int(expected_b);
+        ako_elem_destroy(whole);
+        ako_elem_destroy(egg);
+        if (!same)
+        {
+            printf("Select picked a different a.b than ako_parse for: %s\n", dups[i]);
+            return 1;
+        }
+    }
+
+    // Including dotted keys clashing with skipped tables, even when neither is selected
+    const char* clashes[] = {"a [ b 1 b.c 2 ] z 3", "a [ b 1 ] a.b.c 2 z 3"};
+    const char* z = "z";
+    for (size_t i = 0; i < sizeof(clashes) / sizeof(clashes[0]); ++i)
+    {
+        ako_elem_t* expected_err = ako_parse(clashes[i]);
+        egg = ako_parse_select_ex(clashes[i], strlen(clashes[i]), &z, 1, &opts);
+        bool same = egg != NULL && ako_elem_is_error(egg) &&
+                    strcmp(ako_elem_get_string(egg), ako_elem_get_string(expected_err)) == 0;
+        ako_elem_destroy(expected_err);
+        if (egg != NULL)
+        {
+            ako_elem_destroy(egg);
+        }
+        if (!same)
+        {
+            printf("Expected the same error as ako_parse for: %s\n", clashes[i]);
+            return 1;
+        }
+    }
+
+    const char* unclosed = "keep 1 skip [[ 1 2";
+    egg = ako_parse_select(unclosed, strlen(unclosed), &keep, 1);
+    if (egg == NULL || !ako_elem_is_error(egg))
+    {
+        printf("Expected an error from the unclosed array\n");
+        return 1;
+    }
+    ako_elem_destroy(egg);
+
+    const char* invalid = "a.";
+    egg = ako_parse_select(source, strlen(source), &invalid, 1);
+    if (egg == NULL || !ako_elem_is_error(egg))
+    {
+        printf("Expected an error from an invalid path\n");
+        return 1;
+    }
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+int skip_long_subtrees()
+{
+    // Strings, escapes and comments land on every spot of the 64 byte blocks the skipper works in
+    const char* body = "a \"[[ \\\" ]\" b [ c \"x\\\\\" d [[ 1 2 [ e 3 ] ]] ] # ] [ \"\n f [ ] ";
+    const char* keep = "keep";
+    char source[1024];
+    for (int pad = 0; pad < 64; ++pad)
+    {
+        int len = snprintf(source, sizeof(source), "skip [ %*s", pad, "");
+        for (int i = 0; i < 6; ++i)
+        {
+            len += snprintf(source + len, sizeof(source) - len, "%s", body);
+        }
+        len += snprintf(source + len, sizeof(source) - len, "] keep 7");
+
+        ako_elem_t* selected = ako_parse_select(source, (size_t)len, &keep, 1);
+        ASSERT_ELEM(selected);
+        ako_elem_t* kept = ako_elem_get(selected, "keep");
+        if (kept == NULL || ako_elem_get_int(kept) != 7 || ako_elem_get(selected, "skip") != NULL)
+        {
+            printf("Skipped the wrong amount with %d bytes of padding\n", pad);
+            ako_elem_destroy(selected);
+            return 1;
+        }
+        ako_elem_destroy(selected);
+    }
+    return 0;
+}
+
+// Parses source in one go and on nthreads threads, both have to serialise the same
+static int parallel_matches(const char* source, size_t length, size_t nthreads)
+{
+    ako_elem_t* expected_elem = ako_parse_n(source, length);
+    ako_elem_t* actual_elem = ako_parse_parallel(source, length, nthreads);
+    const char* expected = ako_elem_is_error(expected_elem) ? ako_elem_get_string(expected_elem)
+                                                            : ako_serialize(expected_elem, NULL, ASF_NONE);
+    const char* actual = ako_elem_is_error(actual_elem) ? ako_elem_get_string(actual_elem)
+                                                        : ako_serialize(actual_elem, NULL, ASF_NONE);
+    int result = strcmp(expected, actual) != 0 || ako_elem_is_error(expected_elem) != ako_elem_is_error(actual_elem);
+    if (result != 0)
+    {
+        printf("Parallel parse didn't match:\n%.200s\n%.200s\n", actual, expected);
+    }
+    if (!ako_elem_is_error(expected_elem))
+    {
+        ako_free_string(expected);
+    }
+    if (!ako_elem_is_error(actual_elem))
+    {
+        ako_free_string(actual);
+    }
+    ako_elem_destroy(expected_elem);
+    ako_elem_destroy(actual_elem);
+    return result;
+}
+
+int parse_parallel()
+{
+    // Big enough to get split, dotted keys and duplicates are spread over every piece
+    size_t capacity = 1 << 20;
+    char* source = malloc(capacity);
+    size_t length = 0;
+    for (int i = 0; i < 8000; ++i)
+    {
+        length += snprintf(source + length, capacity - length, "t%d [ x %d s \"] [\" # ]\n ] ", i, i);
+        if (i % 100 == 0)
+        {
+            length += snprintf(source + length, capacity - length, "shared.k%d %d +flags.f%d dup %d ", i, i, i, i);
+        }
+        if (i == 4000)
+        {
+            // Dotted keys later on go into the first one, not this one
+            length += snprintf(source + length, capacity - length, "shared [ again 1 ] ");
+        }
+    }
+    length += snprintf(source + length, capacity - length, "shared.last 1 nested.a.b [[ 1 2 ]] nested.a.c 3");
+    int result = parallel_matches(source, length, 4);
+    if (result == 0)
+    {
+        // Far more threads than there could ever be pieces
+        result = parallel_matches(source, length, SIZE_MAX);
+    }
+
+    // Has to give back the same error too, and stop at the same place when the root gets closed early
+    const char* tails[] = {" t5.y 2 nested.a.b.c 1", " ] ignored [ 1 ]"};
+    for (int i = 0; i < 2 && result == 0; ++i)
+    {
+        size_t tail_length = strlen(tails[i]);
+        memcpy(source + length, tails[i], tail_length);
+        result = parallel_matches(source, length + tail_length, 4);
+    }
+
+    free(source);
+    return result;
+}
+
+#define BATCH_COUNT 200
+
+int parse_batch()
+{
+    // Sizes all over the place so they finish out of order
+    char* sources[BATCH_COUNT];
+    size_t lengths[BATCH_COUNT];
+    for (int i = 0; i < BATCH_COUNT; ++i)
+    {
+        size_t capacity = 64 + (i % 7 == 0 ? 40000 : 0);
+        sources[i] = malloc(capacity);
+        lengths[i] = snprintf(sources[i], capacity, "id %d name \"host%d\" ", i, i);
+        while (lengths[i] + 32 < capacity)
+        {
+            lengths[i] += snprintf(sources[i] + lengths[i], capacity - lengths[i], "pad.x%zu 1 ", lengths[i]);
+        }
+    }
+    lengths[3] = snprintf(sources[3], 64, "broken [");
+    lengths[4] = 0;
+    sources[4][0] = '\0';
+
+    ako_elem_t* out[BATCH_COUNT];
+    int result = 0;
+    for (int pass = 0; pass < 2 && result == 0; ++pass)
+    {
+        // Second time through the sources are found by their NUL
+        ako_parse_batch((const char**)sources, pass == 0 ? lengths : NULL, BATCH_COUNT, out, pass == 0 ? 4 : 0);
+        for (int i = 0; i < BATCH_COUNT; ++i)
+        {
+            ako_elem_t* expected = ako_parse_n(sources[i], lengths[i]);
+            bool matches = i == 4 ? out[i] == NULL
+                                  : out[i] != NULL && ako_elem_get_type(out[i]) == ako_elem_get_type(expected);
+            if (!matches)
+            {
+                printf("Batch result %d doesn't match\n", i);
+                result = 1;
+            }
+            else if (i != 3 && i != 4 && ako_elem_get_int(ako_elem_get(out[i], "id")) != i)
+            {
+                printf("Batch result %d is in the wrong place\n", i);
+                result = 1;
+            }
+            if (expected != NULL)
+            {
+                ako_elem_destroy(expected);
+            }
+            if (out[i] != NULL)
+            {
+                ako_elem_destroy(out[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < BATCH_COUNT; ++i)
+    {
+        free(sources[i]);
+    }
+    return result;
+}
+
+static size_t reuse_mallocs = 0;
+
+static void* counting_malloc(size_t size)
+{
+    reuse_mallocs++;
+    return malloc(size);
+}
+
+int reuse_parser()
+{
+    // Escaped keys and deep nesting so the parser's own buffers get used too
+    const char* sources[] = {
+        "name \"ako\" window [ size 800x600 title \"hi\" ] list [[ 1 2 3 ]] kind &type.a",
+        "\"odd \\\"key\\\"\" 1 a.b.c [ d [ e [ f [ g [[ [[ [[ 1 ]] ]] ]] ] ] ] ] +flag",
+        "broken [ a 1",
+        "",
+        "[[ 1 2.5 \"three\" ]]",
+        "a [ b [ c [ d 1 ] ] ]",
+    };
+    size_t count = sizeof(sources) / sizeof(sources[0]);
+
+    ako_parse_opts_t opts;
+    memset(&opts, 0, sizeof(ako_parse_opts_t));
+    opts.max_depth = 12;
+    ako_parser_t* parser = ako_parser_create(&opts);
+    int result = 0;
+    for (int round = 0; round < 3 && result == 0; ++round)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t length = strlen(sources[i]);
+            ako_elem_t* got = ako_parser_parse(parser, sources[i], length);
+            ako_elem_t* expected = ako_parse_ex(sources[i], length, &opts);
+            if (expected == NULL || got == NULL)
+            {
+                if (expected != got)
+                {
+                    printf("Reused parser gave back the wrong thing for source %zu\n", i);
+                    result = 1;
+                }
+                continue;
+            }
+
+            bool got_error = ako_elem_is_error(got);
+            bool is_error = ako_elem_is_error(expected);
+            const char* got_str = got_error ? ako_elem_get_string(got) : ako_serialize(got, NULL, ASF_NONE);
+            const char* expected_str = is_error ? ako_elem_get_string(expected)
+                                                : ako_serialize(expected, NULL, ASF_NONE);
+            if (got_error != is_error || strcmp(got_str, expected_str) != 0)
+            {
+                printf("Reused parser doesn't match for source %zu:\n%s\n%s\n", i, got_str, expected_str);
+                result = 1;
+            }
+            if (!got_error)
+            {
+                ako_free_string(got_str);
+            }
+            if (!is_error)
+            {
+                ako_free_string(expected_str);
+            }
+            ako_elem_destroy(expected);
+        }
+    }
+
+    // Parsing something it's already seen shouldn't need any more memory, errors aside
+    ako_alloc_t* alloc = ako_alloc_get();
+    void* (*old_malloc)(size_t) = alloc->malloc_func;
+    alloc->malloc_func = counting_malloc;
+    reuse_mallocs = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i != 2)
+        {
+            ako_parser_parse(parser, sources[i], strlen(sources[i]));
+        }
+    }
+    alloc->malloc_func = old_malloc;
+    if (result == 0 && reuse_mallocs != 0)
+    {
+        printf("Reused parser still allocated %zu times\n", reuse_mallocs);
+        result = 1;
+    }
+
+    ako_parser_destroy(parser);
+    return result;
+}
+
+int stream_parse()
+{
+    const char* source = "# settings\n"
+                         "window [ size 1280x720 title \"A \\\"long\\\" title\\\\\" scale 1.25 ]\n"
+                         "+vsync ;cursor theme &Themes.Dark # trailing\n"
+                         "recent [[ \"a\" \"b\" [[ 1 2 ]] ]]";
+    size_t length = strlen(source);
+
+    ako_elem_t* expected_elem = ako_parse(source);
+    ASSERT_ELEM(expected_elem);
+    const char* expected = ako_serialize(expected_elem, NULL, ASF_NONE);
+    ako_elem_destroy(expected_elem);
+
+    // Every chunk size, so every token gets cut in half somewhere
+    for (size_t chunk = 1; chunk <= length; ++chunk)
+    {
+        ako_stream_t* stream = ako_stream_begin();
+        for (size_t i = 0; i < length; i += chunk)
+        {
+            size_t size = length - i < chunk ? length - i : chunk;
+            ako_stream_feed(stream, source + i, size);
+        }
+
+        ako_elem_t* egg = ako_stream_finish(stream);
+        ASSERT_ELEM(egg);
+        const char* actual = ako_serialize(egg, NULL, ASF_NONE);
+        ako_elem_destroy(egg);
+        if (strcmp(expected, actual) != 0)
+        {
+            printf("Chunk size %zu gave: %s\nExpected: %s\n", chunk, actual, expected);
+            ako_free_string(actual);
+            ako_free_string(expected);
+            return 1;
+        }
+        ako_free_string(actual);
+    }
+    ako_free_string(expected);
+
+    // A string missing its closing quote runs to the end
+    ako_stream_t* stream = ako_stream_begin();
+    ako_stream_feed(stream, "a \"open", 7);
+    ako_stream_feed(stream, " \\\"string", 9);
+    ako_elem_t* open = ako_stream_finish(stream);
+    ASSERT_ELEM(open);
+    ASSERT_ELEM_STR(ako_elem_table_get(open, "a"), "open \"string");
+    ako_elem_destroy(open);
+
+    // Errors come back from finish
+    stream = ako_stream_begin();
+    ako_stream_feed(stream, "a 1x", 4);
+    ako_elem_t* egg = ako_stream_finish(stream);
+    if (egg == NULL || !ako_elem_is_error(egg))
+    {
+        printf("Expected an error from a vector cut short\n");
+        return 1;
+    }
+    ako_elem_destroy(egg);
+
+    // Parsing keeps up with feeding, so a mistake shows up before the rest is fed
+    stream = ako_stream_begin();
+    bool fed = ako_stream_feed(stream, "a 1 b [ 5 ] c ", 14);
+    egg = ako_stream_finish(stream);
+    ako_elem_t* expected_err = ako_parse("a 1 b [ 5 ] c ");
+    bool same = egg != NULL && ako_elem_is_error(egg) &&
+                strcmp(ako_elem_get_string(egg), ako_elem_get_string(expected_err)) == 0;
+    ako_elem_destroy(expected_err);
+    if (egg != NULL)
+    {
+        ako_elem_destroy(egg);
+    }
+    if (fed || !same)
+    {
+        printf("Stream didn't report a parse error while feeding\n");
+        return 1;
+    }
+
+    // Once the root closes nothing after it matters, even things that wouldn't lex
+    stream = ako_stream_begin();
+    fed = ako_stream_feed(stream, "a 1 ] ", 6) && ako_stream_feed(stream, "@@ \"", 4);
+    egg = ako_stream_finish(stream);
+    if (!fed || egg == NULL || ako_elem_is_error(egg) || ako_elem_get_int(ako_elem_table_get(egg, "a")) != 1)
+    {
+        printf("Stream didn't stop at the end of the root\n");
+        return 1;
+    }
+    ako_elem_destroy(egg);
+    return 0;
+}
+
+static test_t tests[] = {
+    {"Basic parsing", &basic_parse},
+    {"Basic value first parsing", &basic_value_first},
+    {"Slice parsing", &parse_slice},
+    {"Float parsing", &parse_float},
+    {"String escape parsing", &parse_string_esc},
+    {"Mixed string parsing", &parse_string_mixed},
+    {"Comment parsing", &parse_comments},
+    {"Parse errors", &parse_errors},
+    {"Parse depth", &parse_depth},
+    {"Parse error locations", &parse_error_locations},
+    {"Escaped key parsing", &parse_escaped_keys},
+    {"Number parsing", &parse_numbers},
+    {"UTF-8 key parsing", &parse_utf8_keys},
+    {"Short type parsing", &parse_short_type},
+    {"Multi short type parsing", &parse_multi_short_type},
+
+    // Serialisation tests
+    {"Basic serialisation", &basic_serialise},
+
+    // Unicode
+    // {"Unicode parsing", &unicode_parse},
+
+    // Utils
+    {"Utility Get", &util_get},
+    {"Compiled paths", &compiled_paths},
+    {"Big table", &big_table},
+    {"Interned keys", &interned_keys},
+    {"Document parsing", &doc_parse},
+    {"Lazy documents", &lazy_doc},
+    {"Inline entries", &inline_entries},
+    {"Packed arrays", &packed_arrays},
+    {"Vector parsing", &parse_vectors},
+    {"Selective parsing", &parse_select},
+    {"Skipping long subtrees", &skip_long_subtrees},
+    {"Parallel parsing", &parse_parallel},
+    {"Batch parsing", &parse_batch},
+    {"Reusing a parser", &reuse_parser},
+
+    // Streaming
+    {"Stream parsing", &stream_parse},
+    {"Event parsing", &parse_events},
     {NULL, NULL} // Null terminator
 };
 
@@ -52,6 +52,7 @@ char* read_stdin_all()
 static struct
 {
     char* source;
+    size_t source_len;
     ako_elem_t* result;
 } state;
 
@@ -139,6 +140,7 @@ int main(int argc, char **argv)
     if (read_from_stdin)
     {
         state.source = read_stdin_all();
+        state.source_len = state.source != NULL ? strlen(state.source) : 0;
     }
     else
     {
@@ -165,13 +167,11 @@ int main(int argc, char **argv)
             fclose(file);
             return 1;
         }
-        size_t ignored = fread((char*)state.source, 1, file_size, file);
-        (void)ignored;
-        ((char*)state.source)[file_size] = '\0';
+        state.source_len = fread((char*)state.source, 1, file_size, file);
         fclose(file);
     }
 
-    state.result = ako_parse(state.source);
+    state.result = ako_parse_n(state.source, state.source_len);
     if (validate)
     {
         if (state.result == NULL || ako_elem_is_error(state.result))